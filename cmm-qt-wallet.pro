@@ -38,18 +38,32 @@ SOURCES += \
     src/mainwindow.cpp \
     src/rpc.cpp \
     src/balancestablemodel.cpp \
+    src/addressbalancesmodel.cpp \
     src/3rdparty/qrcode/BitBuffer.cpp \
     src/3rdparty/qrcode/QrCode.cpp \
     src/3rdparty/qrcode/QrSegment.cpp \
     src/settings.cpp \
     src/sendtab.cpp \
     src/senttxstore.cpp \
+    src/walletstore.cpp \
+    src/ioexecutor.cpp \
     src/txtablemodel.cpp \
+    src/txsearchindex.cpp \
 	src/turnstile.cpp \
     src/qrcodelabel.cpp \
     src/connection.cpp \
     src/fillediconlabel.cpp \
     src/addressbook.cpp \
+    src/addressvalidator.cpp \
+    src/paymentqrbatch.cpp \
+    src/paramsdownloader.cpp \
+    src/paramsverifier.cpp \
+    src/daemonstartup.cpp \
+    src/daemontuning.cpp \
+    src/daemonmonitor.cpp \
+    src/daemonthrottle.cpp \
+    src/syncmonitor.cpp \
+    src/sparkline.cpp \
     src/logger.cpp \
     src/addresscombo.cpp
 
@@ -58,18 +72,32 @@ HEADERS += \
     src/precompiled.h \
     src/rpc.h \
     src/balancestablemodel.h \
+    src/addressbalancesmodel.h \
     src/3rdparty/qrcode/BitBuffer.hpp \
     src/3rdparty/qrcode/QrCode.hpp \
     src/3rdparty/qrcode/QrSegment.hpp \
     src/3rdparty/json/json.hpp \
     src/settings.h \
     src/txtablemodel.h \
+    src/txsearchindex.h \
     src/senttxstore.h \
+    src/walletstore.h \
+    src/ioexecutor.h \
 	src/turnstile.h \
     src/qrcodelabel.h \
     src/connection.h \
     src/fillediconlabel.h \
     src/addressbook.h \
+    src/addressvalidator.h \
+    src/paymentqrbatch.h \
+    src/paramsdownloader.h \
+    src/paramsverifier.h \
+    src/daemonstartup.h \
+    src/daemontuning.h \
+    src/daemonmonitor.h \
+    src/daemonthrottle.h \
+    src/syncmonitor.h \
+    src/sparkline.h \
     src/logger.h \
     src/addresscombo.h 
 
@@ -28,6 +28,7 @@
 #include <sstream>
 #include <stdexcept>
 #include <utility>
+#include <initializer_list>
 #include "BitBuffer.hpp"
 #include "QrCode.hpp"
 
@@ -315,31 +316,26 @@ vector<uint8_t> QrCode::addEccAndInterleave(const vector<uint8_t> &data) const {
 	int rawCodewords = getNumRawDataModules(version) / 8;
 	int numShortBlocks = numBlocks - rawCodewords % numBlocks;
 	int shortBlockLen = rawCodewords / numBlocks;
+	int shortDataLen = shortBlockLen - blockEccLen;
 	
-	// Split data into blocks and append ECC to each block
-	vector<vector<uint8_t> > blocks;
-	const ReedSolomonGenerator rs(blockEccLen);
+	// Write the data and the ECC of every block straight to its interleaved (not concatenated)
+	// position in the result. Long blocks have one more data byte, which goes after all the
+	// bytes the blocks have in common. The ECC bytes follow all the data bytes.
+	vector<uint8_t> result(rawCodewords);
+	uint8_t ecc[255];
+	const ReedSolomonGenerator &rs = ReedSolomonGenerator::forDegree(blockEccLen);
 	for (int i = 0, k = 0; i < numBlocks; i++) {
-		vector<uint8_t> dat(data.cbegin() + k, data.cbegin() + (k + shortBlockLen - blockEccLen + (i < numShortBlocks ? 0 : 1)));
-		k += dat.size();
-		const vector<uint8_t> ecc = rs.getRemainder(dat);
-		if (i < numShortBlocks)
-			dat.push_back(0);
-		dat.insert(dat.end(), ecc.cbegin(), ecc.cend());
-		blocks.push_back(std::move(dat));
+		int datLen = shortDataLen + (i < numShortBlocks ? 0 : 1);
+		for (int j = 0; j < shortDataLen; j++)
+			result[j * numBlocks + i] = data[k + j];
+		if (i >= numShortBlocks)
+			result[shortDataLen * numBlocks + i - numShortBlocks] = data[k + shortDataLen];
+		
+		rs.getRemainder(&data[k], datLen, ecc);
+		for (int j = 0; j < blockEccLen; j++)
+			result[data.size() + j * numBlocks + i] = ecc[j];
+		k += datLen;
 	}
-	
-	// Interleave (not concatenate) the bytes from every block into a single sequence
-	vector<uint8_t> result;
-	for (size_t i = 0; i < blocks.at(0).size(); i++) {
-		for (size_t j = 0; j < blocks.size(); j++) {
-			// Skip the padding byte in short blocks
-			if (i != static_cast<unsigned int>(shortBlockLen - blockEccLen) || j >= static_cast<unsigned int>(numShortBlocks))
-				result.push_back(blocks.at(j).at(i));
-		}
-	}
-	if (result.size() != static_cast<unsigned int>(rawCodewords))
-		throw std::logic_error("Assertion error");
 	return result;
 }
 
@@ -376,37 +372,141 @@ void QrCode::applyMask(int mask) {
 	if (mask < 0 || mask > 7)
 		throw std::domain_error("Mask value out of range");
 	for (int y = 0; y < size; y++) {
-		for (int x = 0; x < size; x++) {
-			bool invert;
-			switch (mask) {
-				case 0:  invert = (x + y) % 2 == 0;                    break;
-				case 1:  invert = y % 2 == 0;                          break;
-				case 2:  invert = x % 3 == 0;                          break;
-				case 3:  invert = (x + y) % 3 == 0;                    break;
-				case 4:  invert = (x / 3 + y / 2) % 2 == 0;            break;
-				case 5:  invert = x * y % 2 + x * y % 3 == 0;          break;
-				case 6:  invert = (x * y % 2 + x * y % 3) % 2 == 0;    break;
-				case 7:  invert = ((x + y) % 2 + x * y % 3) % 2 == 0;  break;
-				default:  throw std::logic_error("Assertion error");
-			}
-			modules.at(y).at(x) = modules.at(y).at(x) ^ (invert & !isFunction.at(y).at(x));
-		}
+		for (int x = 0; x < size; x++)
+			modules.at(y).at(x) = modules.at(y).at(x) ^ (maskInverts(mask, x, y) & !isFunction.at(y).at(x));
 	}
 }
 
 
+bool QrCode::maskInverts(int mask, int x, int y) {
+	switch (mask) {
+		case 0:  return (x + y) % 2 == 0;
+		case 1:  return y % 2 == 0;
+		case 2:  return x % 3 == 0;
+		case 3:  return (x + y) % 3 == 0;
+		case 4:  return (x / 3 + y / 2) % 2 == 0;
+		case 5:  return x * y % 2 + x * y % 3 == 0;
+		case 6:  return (x * y % 2 + x * y % 3) % 2 == 0;
+		case 7:  return ((x + y) % 2 + x * y % 3) % 2 == 0;
+		default:  throw std::logic_error("Assertion error");
+	}
+}
+
+
+/*---- Bitboards for scoring masks ----*/
+
+struct QrCode::BitLine final {
+	
+	// 3 words hold the largest size, 177
+	static constexpr int WORDS = 3;
+	
+	std::uint64_t words[WORDS] = {};
+	
+	
+	bool get(int i) const {
+		return ((words[i >> 6] >> (i & 63)) & 1) != 0;
+	}
+	
+	void set(int i, bool value) {
+		std::uint64_t bit = static_cast<std::uint64_t>(1) << (i & 63);
+		words[i >> 6] = value ? (words[i >> 6] | bit) : (words[i >> 6] & ~bit);
+	}
+	
+	void flip(int i) {
+		words[i >> 6] ^= static_cast<std::uint64_t>(1) << (i & 63);
+	}
+	
+	// Bit i of the result is bit i+k of this line, for 0 < k < 64
+	BitLine shiftDown(int k) const {
+		BitLine r;
+		for (int i = 0; i < WORDS; i++)
+			r.words[i] = (words[i] >> k) | (i + 1 < WORDS ? words[i + 1] << (64 - k) : 0);
+		return r;
+	}
+	
+	// Bit i of the result is bit i-1 of this line
+	BitLine shiftUp() const {
+		BitLine r;
+		for (int i = 0; i < WORDS; i++)
+			r.words[i] = (words[i] << 1) | (i > 0 ? words[i - 1] >> 63 : 0);
+		return r;
+	}
+	
+	// A line with only the lowest n bits set
+	static BitLine lowBits(int n) {
+		BitLine r;
+		for (int i = 0; i < WORDS; i++) {
+			int bits = std::max(0, std::min(64, n - i * 64));
+			r.words[i] = bits == 64 ? ~static_cast<std::uint64_t>(0) : (static_cast<std::uint64_t>(1) << bits) - 1;
+		}
+		return r;
+	}
+	
+	int count() const {
+		int result = 0;
+		for (std::uint64_t w : words) {
+#if defined(__GNUC__)
+			result += __builtin_popcountll(w);
+#else
+			w = w - ((w >> 1) & 0x5555555555555555ULL);
+			w = (w & 0x3333333333333333ULL) + ((w >> 2) & 0x3333333333333333ULL);
+			w = (w + (w >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+			result += static_cast<int>((w * 0x0101010101010101ULL) >> 56);
+#endif
+		}
+		return result;
+	}
+	
+	BitLine operator&(const BitLine &o) const { BitLine r; for (int i = 0; i < WORDS; i++) r.words[i] = words[i] & o.words[i]; return r; }
+	BitLine operator|(const BitLine &o) const { BitLine r; for (int i = 0; i < WORDS; i++) r.words[i] = words[i] | o.words[i]; return r; }
+	BitLine operator^(const BitLine &o) const { BitLine r; for (int i = 0; i < WORDS; i++) r.words[i] = words[i] ^ o.words[i]; return r; }
+	BitLine operator~() const { BitLine r; for (int i = 0; i < WORDS; i++) r.words[i] = ~words[i]; return r; }
+	
+};
+
+
 int QrCode::handleConstructorMasking(int mask) {
 	if (mask == -1) {  // Automatically choose best mask
+		// Pack the unmasked modules into row and column bitboards once. Each mask is then
+		// applied to a copy of the bitboards and scored with word-level operations.
+		vector<BitLine> rows(size), cols(size);
+		vector<BitLine> maskable(size);  // Rows of the modules that are not function modules
+		for (int y = 0; y < size; y++) {
+			for (int x = 0; x < size; x++) {
+				rows.at(y).set(x, module(x, y));
+				cols.at(x).set(y, module(x, y));
+				maskable.at(y).set(x, !isFunction.at(y).at(x));
+			}
+		}
+		
 		long minPenalty = LONG_MAX;
 		for (int i = 0; i < 8; i++) {
 			drawFormatBits(i);
-			applyMask(i);
-			long penalty = getPenaltyScore();
+			vector<BitLine> maskedRows(rows), maskedCols(cols);
+			
+			// The format bits are all in row 8 and column 8
+			for (int j = 0; j < size; j++) {
+				maskedRows.at(8).set(j, module(j, 8));
+				maskedCols.at(j).set(8, module(j, 8));
+				maskedCols.at(8).set(j, module(8, j));
+				maskedRows.at(j).set(8, module(8, j));
+			}
+			
+			for (int y = 0; y < size; y++) {
+				const BitLine &m = maskable.at(y);
+				for (int x = 0; x < size; x++) {
+					if (maskInverts(i, x, y) && m.get(x)) {
+						maskedRows.at(y).flip(x);
+						maskedCols.at(x).flip(y);
+					}
+				}
+			}
+			
+			long penalty = getPenaltyScore(maskedRows, maskedCols, size);
 			if (penalty < minPenalty) {
 				mask = i;
 				minPenalty = penalty;
 			}
-			applyMask(i);  // Undoes the mask due to XOR
 		}
 	}
 	if (mask < 0 || mask > 7)
@@ -417,78 +517,48 @@ int QrCode::handleConstructorMasking(int mask) {
 }
 
 
-long QrCode::getPenaltyScore() const {
+long QrCode::getPenaltyScore(const vector<BitLine> &rows, const vector<BitLine> &cols, int size) {
 	long result = 0;
 	
-	// Adjacent modules in row having same color
-	for (int y = 0; y < size; y++) {
-		bool colorX = false;
-		for (int x = 0, runX = -1; x < size; x++) {
-			if (x == 0 || module(x, y) != colorX) {
-				colorX = module(x, y);
-				runX = 1;
-			} else {
-				runX++;
-				if (runX == 5)
-					result += PENALTY_N1;
-				else if (runX > 5)
-					result++;
-			}
-		}
-	}
-	// Adjacent modules in column having same color
-	for (int x = 0; x < size; x++) {
-		bool colorY = false;
-		for (int y = 0, runY = -1; y < size; y++) {
-			if (y == 0 || module(x, y) != colorY) {
-				colorY = module(x, y);
-				runY = 1;
-			} else {
-				runY++;
-				if (runY == 5)
-					result += PENALTY_N1;
-				else if (runY > 5)
-					result++;
+	// Finder-like patterns, as they are read from the start of the line (the first module is the highest bit)
+	static const int FINDER_PATTERNS[] = {0x05D, 0x5D0};
+	
+	const BitLine sameValid   = BitLine::lowBits(size - 1);
+	const BitLine finderValid = BitLine::lowBits(size - 10);
+	
+	// Rules that apply to both rows and columns
+	for (const vector<BitLine> *lines : {&rows, &cols}) {
+		for (const BitLine &line : *lines) {
+			// Adjacent modules having same color. Bit i of runs is set iff modules i to i+4 all have
+			// the same color, so a run of length n >= 5 sets n-4 bits and scores n-2 points.
+			BitLine same = ~(line ^ line.shiftDown(1)) & sameValid;
+			BitLine runs = same & same.shiftDown(1) & same.shiftDown(2) & same.shiftDown(3);
+			result += runs.count() + (PENALTY_N1 - 1) * (runs & ~runs.shiftUp()).count();
+			
+			// Finder-like patterns. Bit i of match is set iff the 11 modules starting at i match.
+			for (int pattern : FINDER_PATTERNS) {
+				BitLine match = finderValid;
+				for (int k = 0; k <= 10; k++) {
+					BitLine shifted = k == 0 ? line : line.shiftDown(k);
+					match = match & (((pattern >> (10 - k)) & 1) != 0 ? shifted : ~shifted);
+				}
+				result += static_cast<long>(match.count()) * PENALTY_N3;
 			}
 		}
 	}
 	
 	// 2*2 blocks of modules having same color
 	for (int y = 0; y < size - 1; y++) {
-		for (int x = 0; x < size - 1; x++) {
-			bool  color = module(x, y);
-			if (  color == module(x + 1, y) &&
-			      color == module(x, y + 1) &&
-			      color == module(x + 1, y + 1))
-				result += PENALTY_N2;
-		}
-	}
-	
-	// Finder-like pattern in rows
-	for (int y = 0; y < size; y++) {
-		for (int x = 0, bits = 0; x < size; x++) {
-			bits = ((bits << 1) & 0x7FF) | (module(x, y) ? 1 : 0);
-			if (x >= 10 && (bits == 0x05D || bits == 0x5D0))  // Needs 11 bits accumulated
-				result += PENALTY_N3;
-		}
-	}
-	// Finder-like pattern in columns
-	for (int x = 0; x < size; x++) {
-		for (int y = 0, bits = 0; y < size; y++) {
-			bits = ((bits << 1) & 0x7FF) | (module(x, y) ? 1 : 0);
-			if (y >= 10 && (bits == 0x05D || bits == 0x5D0))  // Needs 11 bits accumulated
-				result += PENALTY_N3;
-		}
+		const BitLine &top = rows.at(y);
+		BitLine vertical = top ^ rows.at(y + 1);
+		BitLine blocks = ~(vertical | vertical.shiftDown(1) | (top ^ top.shiftDown(1))) & sameValid;
+		result += static_cast<long>(blocks.count()) * PENALTY_N2;
 	}
 	
 	// Balance of black and white modules
 	int black = 0;
-	for (const vector<bool> &row : modules) {
-		for (bool color : row) {
-			if (color)
-				black++;
-		}
-	}
+	for (const BitLine &row : rows)
+		black += row.count();
 	int total = size * size;  // Note that size is odd, so black/total != 1/2
 	// Compute the smallest integer k >= 0 such that (45-5k)% <= black/total <= (55+5k)%
 	int k = static_cast<int>((std::abs(black * 20L - total * 10L) + total - 1) / total) - 1;
@@ -566,6 +636,34 @@ const int8_t QrCode::NUM_ERROR_CORRECTION_BLOCKS[4][41] = {
 };
 
 
+namespace {
+
+// Log and antilog tables of GF(2^8/0x11D), with generator 0x02. The antilog table is
+// doubled so the sum of two logs can be looked up without reducing it modulo 255.
+struct GaloisTables final {
+	uint8_t exp[512];
+	uint8_t log[256];
+	
+	GaloisTables() : exp(), log() {
+		int x = 1;
+		for (int i = 0; i < 255; i++) {
+			exp[i] = exp[i + 255] = static_cast<uint8_t>(x);
+			log[x] = static_cast<uint8_t>(i);
+			x = (x << 1) ^ ((x >> 7) * 0x11D);
+		}
+		exp[510] = exp[0];
+		exp[511] = exp[1];
+	}
+};
+
+const GaloisTables &galoisTables() {
+	static const GaloisTables tables;
+	return tables;
+}
+
+}
+
+
 QrCode::ReedSolomonGenerator::ReedSolomonGenerator(int degree) :
 		coefficients() {
 	if (degree < 1 || degree > 255)
@@ -591,30 +689,55 @@ QrCode::ReedSolomonGenerator::ReedSolomonGenerator(int degree) :
 }
 
 
-vector<uint8_t> QrCode::ReedSolomonGenerator::getRemainder(const vector<uint8_t> &data) const {
+const QrCode::ReedSolomonGenerator &QrCode::ReedSolomonGenerator::forDegree(int degree) {
+	// The QR Code tables use at most 30 ECC codewords per block
+	static const vector<ReedSolomonGenerator> generators = [] () {
+		vector<ReedSolomonGenerator> result;
+		for (int i = 1; i <= 30; i++)
+			result.emplace_back(i);
+		return result;
+	}();
+	
+	if (degree < 1 || degree > static_cast<int>(generators.size()))
+		throw std::domain_error("Degree out of range");
+	return generators[degree - 1];
+}
+
+
+int QrCode::ReedSolomonGenerator::degree() const {
+	return static_cast<int>(coefficients.size());
+}
+
+
+void QrCode::ReedSolomonGenerator::getRemainder(const uint8_t *data, size_t len, uint8_t *result) const {
+	const GaloisTables &gf = galoisTables();
+	const size_t degree = coefficients.size();
+	
+	// Logs of the coefficients, so each step is one table lookup. They are never zero.
+	uint8_t coefLogs[255];
+	for (size_t j = 0; j < degree; j++)
+		coefLogs[j] = gf.log[coefficients[j]];
+	
 	// Compute the remainder by performing polynomial division
-	vector<uint8_t> result(coefficients.size());
-	for (uint8_t b : data) {
-		uint8_t factor = b ^ result.at(0);
-		result.erase(result.begin());
-		result.push_back(0);
-		for (size_t j = 0; j < result.size(); j++)
-			result.at(j) ^= multiply(coefficients.at(j), factor);
+	std::fill(result, result + degree, 0);
+	for (size_t i = 0; i < len; i++) {
+		uint8_t factor = data[i] ^ result[0];
+		std::copy(result + 1, result + degree, result);
+		result[degree - 1] = 0;
+		if (factor == 0)
+			continue;
+		int factorLog = gf.log[factor];
+		for (size_t j = 0; j < degree; j++)
+			result[j] ^= gf.exp[coefLogs[j] + factorLog];
 	}
-	return result;
 }
 
 
 uint8_t QrCode::ReedSolomonGenerator::multiply(uint8_t x, uint8_t y) {
-	// Russian peasant multiplication
-	int z = 0;
-	for (int i = 7; i >= 0; i--) {
-		z = (z << 1) ^ ((z >> 7) * 0x11D);
-		z ^= ((y >> i) & 1) * x;
-	}
-	if (z >> 8 != 0)
-		throw std::logic_error("Assertion error");
-	return static_cast<uint8_t>(z);
+	if (x == 0 || y == 0)
+		return 0;
+	const GaloisTables &gf = galoisTables();
+	return gf.exp[gf.log[x] + gf.log[y]];
 }
 
 }
@@ -23,6 +23,7 @@
 
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <string>
 #include <vector>
@@ -246,15 +247,23 @@ class QrCode final {
 	private: void applyMask(int mask);
 	
 	
+	// Returns true iff the given mask pattern inverts the module at the given coordinates.
+	private: static bool maskInverts(int mask, int x, int y);
+	
+	
 	// A messy helper function for the constructors. This QR Code must be in an unmasked state when this
 	// method is called. The given argument is the requested mask, which is -1 for auto or 0 to 7 for fixed.
 	// This method applies and returns the actual mask chosen, from 0 to 7.
 	private: int handleConstructorMasking(int mask);
 	
 	
-	// Calculates and returns the penalty score based on state of this QR Code's current modules.
+	// One row or column of modules packed into 64-bit words, with bit i holding module i.
+	private: struct BitLine;
+	
+	
+	// Calculates and returns the penalty score of the given modules, packed both as rows and as columns.
 	// This is used by the automatic mask choice algorithm to find the mask pattern that yields the lowest score.
-	private: long getPenaltyScore() const;
+	private: static long getPenaltyScore(const std::vector<BitLine> &rows, const std::vector<BitLine> &cols, int size);
 	
 	
 	
@@ -331,17 +340,26 @@ class QrCode final {
 		/*-- Method --*/
 		
 		/* 
-		 * Computes and returns the Reed-Solomon error correction codewords for the given
-		 * sequence of data codewords. The returned object is always a new byte array.
+		 * Computes the Reed-Solomon error correction codewords for the given sequence of data
+		 * codewords, and writes them to result, which must have room for degree() bytes.
 		 * This method does not alter this object's state (because it is immutable).
 		 */
-		public: std::vector<std::uint8_t> getRemainder(const std::vector<std::uint8_t> &data) const;
+		public: void getRemainder(const std::uint8_t *data, std::size_t len, std::uint8_t *result) const;
+		
+		
+		// Returns the degree of the divisor polynomial, which is the number of ECC codewords per block.
+		public: int degree() const;
+		
+		
+		/*-- Static functions --*/
 		
+		// Returns a shared generator for the given degree. The generators for every degree
+		// used by the QR Code tables are built once, on first use.
+		public: static const ReedSolomonGenerator &forDegree(int degree);
 		
-		/*-- Static function --*/
 		
 		// Returns the product of the two given field elements modulo GF(2^8/0x11D).
-		// All inputs are valid. This could be implemented as a 256*256 lookup table.
+		// All inputs are valid. Uses log and antilog tables.
 		private: static std::uint8_t multiply(std::uint8_t x, std::uint8_t y);
 		
 	};
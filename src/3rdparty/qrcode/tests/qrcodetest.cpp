@@ -0,0 +1,113 @@
+/* 
+ * Checks that the encoder still produces exactly the same symbols as the original
+ * qrcodegen encoder, and times it. See the Makefile in this directory.
+ * 
+ *   qrcodetest          Print one line per symbol: version, ECC level, requested mask,
+ *                       chosen mask and a hash of every module. Compared against expected.txt.
+ *   qrcodetest bench    Time encoding 3000 payment URIs.
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+#include "QrCode.hpp"
+#include "QrSegment.hpp"
+
+using namespace qrcodegen;
+using std::uint8_t;
+
+
+static const QrCode::Ecc eccs[] = {QrCode::Ecc::LOW, QrCode::Ecc::MEDIUM, QrCode::Ecc::QUARTILE, QrCode::Ecc::HIGH};
+
+
+// FNV-1a over the modules, row by row
+static unsigned long long hashModules(const QrCode &qr) {
+	unsigned long long h = 1469598103934665603ULL;
+	for (int y = 0; y < qr.getSize(); y++) {
+		for (int x = 0; x < qr.getSize(); x++)
+			h = (h ^ (qr.getModule(x, y) ? 1 : 0)) * 1099511628211ULL;
+	}
+	return h;
+}
+
+
+static void printSymbol(const QrCode &qr, int ecl, int mask) {
+	std::printf("%d %d %d %d %016llx\n", qr.getVersion(), ecl, mask, qr.getMask(), hashModules(qr));
+}
+
+
+// Largest number of bytes that fits in the given version at the given ECC level
+static int byteCapacity(int version, QrCode::Ecc ecl) {
+	int lo = 1, hi = 2953;
+	while (lo < hi) {
+		int n = (lo + hi + 1) / 2;
+		std::vector<QrSegment> segs{QrSegment::makeBytes(std::vector<uint8_t>(n))};
+		try {
+			QrCode::encodeSegments(segs, ecl, version, version, 0, false);
+			lo = n;
+		} catch (...) {
+			hi = n - 1;
+		}
+	}
+	return lo;
+}
+
+
+static void check() {
+	// std::mt19937 is fully specified, so these are the same bytes everywhere. Its
+	// output is used directly, since the distributions are implementation defined.
+	std::mt19937 rng(12345);
+	
+	// Every version, ECC level and mask, with random data that fills a random share of the symbol
+	for (int version = 1; version <= 40; version++) {
+		for (int e = 0; e < 4; e++) {
+			int capacity = byteCapacity(version, eccs[e]);
+			std::vector<uint8_t> data(1 + rng() % capacity);
+			for (uint8_t &b : data)
+				b = static_cast<uint8_t>(rng());
+			
+			std::vector<QrSegment> segs{QrSegment::makeBytes(data)};
+			for (int mask = -1; mask < 8; mask++)
+				printSymbol(QrCode::encodeSegments(segs, eccs[e], version, version, mask, false), e, mask);
+		}
+	}
+	
+	// The text modes, and the smallest version and ECC boost that the wallet relies on
+	const char *texts[] = {
+		"",
+		"0",
+		"31415926535897932384626433832795028841971693993751058209749445923078164062862089986280348253421170679",
+		"HELLO WORLD $%*+-./:",
+		"commercium:CJ8RxcUSzW1JkD4vcNbnqAhYvgaU7qEjPp?amount=1.5000&memo=invoice",
+		"commercium:zs1gv64eu0v2wx7raxqxlmj354y9ycznwaau9kduljzczxztvs4qcl00kn2sjxtejvrxnkucw5xx9u?amount=0.0001",
+	};
+	for (const char *text : texts) {
+		for (int e = 0; e < 4; e++)
+			printSymbol(QrCode::encodeText(text, eccs[e]), e, -1);
+	}
+}
+
+
+static void bench() {
+	auto start = std::chrono::steady_clock::now();
+	int masks = 0;
+	for (int i = 0; i < 3000; i++) {
+		char uri[200];
+		std::snprintf(uri, sizeof uri, "commercium:CJ8RxcUSzW1JkD4vcNbnqAhYvgaU7qEjPp?amount=%d.%04d&memo=invoice%d", i, i * 7 % 10000, i);
+		masks += QrCode::encodeText(uri, QrCode::Ecc::LOW).getMask();
+	}
+	double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::printf("3000 payment URIs in %.3f s (%d)\n", secs, masks);
+}
+
+
+int main(int argc, char **argv) {
+	if (argc > 1 && std::string(argv[1]) == "bench")
+		bench();
+	else
+		check();
+	return 0;
+}
@@ -0,0 +1,106 @@
+#include "addressbalancesmodel.h"
+#include "addressbook.h"
+#include "settings.h"
+
+AddressBalancesModel::AddressBalancesModel(QObject* parent)
+    : QAbstractListModel(parent) {
+}
+
+/**
+ * Both the current rows and the new balances are sorted by address, so walk them together and 
+ * only remove, insert or update the rows that are different. Runs of adjacent inserts or removes
+ * are applied as a single change.
+ */
+void AddressBalancesModel::setBalances(const QMap<QString, double>& balances) {
+    int  row = 0;
+    auto it  = balances.constBegin();
+
+    while (row < items.size() || it != balances.constEnd()) {
+        // Addresses that are gone
+        int removeCount = 0;
+        while (row + removeCount < items.size() && 
+               (it == balances.constEnd() || items[row + removeCount].first < it.key())) {
+            removeCount++;
+        }
+        if (removeCount > 0) {
+            beginRemoveRows(QModelIndex(), row, row + removeCount - 1);
+            items.erase(items.begin() + row, items.begin() + row + removeCount);
+            endRemoveRows();
+            continue;
+        }
+
+        // New addresses
+        QList<QPair<QString, double>> newItems;
+        while (it != balances.constEnd() && (row >= items.size() || it.key() < items[row].first)) {
+            newItems.push_back(QPair<QString, double>(it.key(), it.value()));
+            it++;
+        }
+        if (!newItems.isEmpty()) {
+            beginInsertRows(QModelIndex(), row, row + newItems.size() - 1);
+            for (int i = 0; i < newItems.size(); i++) {
+                items.insert(row + i, newItems[i]);
+            }
+            endInsertRows();
+
+            row += newItems.size();
+            continue;
+        }
+
+        // Same address, so just see if the balance changed
+        if (items[row].second != it.value()) {
+            items[row].second = it.value();
+            dataChanged(index(row), index(row));
+        }
+        row++;
+        it++;
+    }
+}
+
+// Address labels are part of the displayed text, so repaint everything when they change
+void AddressBalancesModel::labelsChanged() {
+    if (!items.isEmpty())
+        dataChanged(index(0), index(items.size() - 1));
+}
+
+// Row of the address, or -1 if it is not in the model
+int AddressBalancesModel::rowOf(const QString& address) const {
+    auto it = std::lower_bound(items.constBegin(), items.constEnd(), address, 
+        [=] (const QPair<QString, double>& item, const QString& addr) {
+            return item.first < addr;
+        });
+
+    if (it == items.constEnd() || it->first != address)
+        return -1;
+
+    return it - items.constBegin();
+}
+
+int AddressBalancesModel::rowCount(const QModelIndex& parent) const {
+    if (parent.isValid())
+        return 0;
+
+    return items.size();
+}
+
+QVariant AddressBalancesModel::data(const QModelIndex& index, int role) const {
+    if (!index.isValid() || index.row() >= items.size())
+        return QVariant();
+
+    const auto& item = items.at(index.row());
+
+    if (role == Qt::DisplayRole) {
+        // Same format as AddressCombo::addItem
+        QString txt = AddressBook::addLabelToAddress(item.first);
+        if (item.second > 0)
+            txt = txt % "(" % Settings::getCMMDisplayFormat(item.second) % ")";
+        return txt;
+    }
+
+    if (role == AddressRole) 
+        return item.first;
+
+    if (role == Qt::UserRole)
+        return item.second;
+
+    return QVariant();
+}
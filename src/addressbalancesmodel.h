@@ -0,0 +1,30 @@
+#ifndef ADDRESSBALANCESMODEL_H
+#define ADDRESSBALANCESMODEL_H
+
+#include "precompiled.h"
+
+/**
+ * List of addresses and their balances, used as the model for the "pay from" combo box.
+ * New data is applied as a diff against the current rows, so that views keep their selection
+ * (and an open popup) across refreshes.
+ */
+class AddressBalancesModel : public QAbstractListModel
+{
+public:
+    AddressBalancesModel(QObject* parent);
+
+    void     setBalances(const QMap<QString, double>& balances);
+    void     labelsChanged();
+    int      rowOf(const QString& address) const;
+
+    int      rowCount(const QModelIndex &parent) const;
+    QVariant data(const QModelIndex &index, int role) const;
+
+    // Role that returns the raw address, without the label or balance
+    static const int AddressRole = Qt::UserRole + 1;
+
+private:
+    QList<QPair<QString, double>> items;    // Sorted by address, same as the QMap it came from
+};
+
+#endif // ADDRESSBALANCESMODEL_H
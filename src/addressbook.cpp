@@ -2,7 +2,9 @@
 #include "ui_addressbook.h"
 #include "ui_mainwindow.h"
 #include "settings.h"
+#include "addressvalidator.h"
 #include "mainwindow.h"
+#include "walletstore.h"
 
 
 AddressBookModel::AddressBookModel(QTableView *parent)
@@ -40,6 +42,19 @@ void AddressBookModel::addNewLabel(QString label, QString addr) {
     layoutChanged();
 }
 
+// Add many labels at once (eg. from an import), updating the view only once at the end.
+void AddressBookModel::addNewLabels(const QList<QPair<QString, QString>>& newLabels) {
+    for (const auto& item : newLabels) {
+        AddressBook::getInstance()->addAddressLabel(item.first, item.second);
+    }
+
+    labels.clear();
+    labels = AddressBook::getInstance()->getAllAddressLabels();
+
+    dataChanged(index(0, 0), index(labels.size()-1, columnCount(index(0,0))-1));
+    layoutChanged();
+}
+
 void AddressBookModel::removeItemAt(int row) {
     if (row >= labels.size())
         return;
@@ -142,19 +157,28 @@ void AddressBook::open(MainWindow* parent, QLineEdit* target) {
 
         QTextStream in(&file);
         QString line;
-        int numImported = 0;
+        QStringList addrs, labels;
         while (in.readLineInto(&line)) {
             QStringList items = line.split(",");
             if (items.size() != 2)
                 continue;
 
-            if (!Settings::isValidAddress(items.at(0)))
+            addrs.push_back(items.at(0));
+            labels.push_back(items.at(1));
+        }
+
+        // Check all the addresses in one go, and skip the invalid ones
+        auto types = AddressValidator::classify(addrs);
+        QList<QPair<QString, QString>> imported;
+        for (int i = 0; i < addrs.size(); i++) {
+            if (types[i] == AddressValidator::Invalid)
                 continue;
 
             // Add label, address.
-            model.addNewLabel(items.at(1), items.at(0));
-            numImported++;
+            imported.push_back(QPair<QString, QString>(labels.at(i), addrs.at(i)));
         }
+        model.addNewLabels(imported);
+        int numImported = imported.size();
 
         QMessageBox::information(&d, QObject::tr("Address Book Import Done"),
             QObject::tr("Imported %1 new Address book entries").arg(numImported));
@@ -232,31 +256,56 @@ AddressBook::AddressBook() {
     readFromStorage();
 }
 
+// Namespace of the address labels in the wallet store
+static const QString storeNamespace = QStringLiteral("addressbook");
+
 void AddressBook::readFromStorage() {
-    QFile file(AddressBook::writeableFile());
+    ordered.clear();
+    positionByLabel.clear();
+    allLabels.clear();
+    allLabelsDirty = false;
+    addressByLabel.clear();
+    labelsByAddress.clear();
 
-    if (!file.exists()) {
+    auto store = WalletStore::getInstance();
+
+    // Address books written by older versions are moved into the wallet store the first time
+    if (store->isEmpty(storeNamespace) && QFile::exists(AddressBook::writeableFile())) {
+        migrateFromFiles();
         return;
     }
 
-    allLabels.clear();
-    file.open(QIODevice::ReadOnly);
-    QDataStream in(&file);    // read the data serialized from the file
-    QString version;
-    in >> version >> allLabels; 
-
-    file.close();
+    for (const auto& item : store->values(storeNamespace)) {
+        applyAdd(item.first, QString::fromUtf8(item.second));
+    }
 }
 
-void AddressBook::writeToStorage() {
-    if (allLabels.isEmpty())
-        return;
-
+/**
+ * Read addresslabels.dat, and then write all the labels into the wallet store.
+ * The old files are removed once the labels are safely in the store.
+ */
+void AddressBook::migrateFromFiles() {
     QFile file(AddressBook::writeableFile());
-    file.open(QIODevice::ReadWrite | QIODevice::Truncate);
-    QDataStream out(&file);   // we will serialize the data into the file
-    out << QString("v1") << allLabels;
-    file.close();
+    if (file.open(QIODevice::ReadOnly)) {
+        QDataStream in(&file);    // read the data serialized from the file
+        QString version;
+        QList<QPair<QString, QString>> labels;
+        in >> version >> labels; 
+        file.close();
+
+        for (const auto& item : labels) {
+            applyAdd(item.first, item.second);
+        }
+    }
+
+    auto store = WalletStore::getInstance();
+    for (const auto& item : ordered) {
+        store->put(storeNamespace, item.first, item.second.toUtf8());
+    }
+
+    if (store->sync()) {
+        QFile::remove(AddressBook::writeableFile());
+    }
 }
 
 QString AddressBook::writeableFile() {
@@ -273,61 +322,110 @@ QString AddressBook::writeableFile() {
     }
 }
 
+void AddressBook::applyAdd(const QString& label, const QString& address) {
+    // Labels are unique, so first remove any existing entry with this label
+    auto existing = addressByLabel.constFind(label);
+    if (existing != addressByLabel.constEnd()) {
+        applyRemove(label, existing.value());
+    }
+
+    ordered.insert(nextPosition, QPair<QString, QString>(label, address));
+    positionByLabel.insert(label, nextPosition++);
+    allLabelsDirty = true;
+    addressByLabel.insert(label, address);
+    labelsByAddress[address].push_back(label);
+}
+
+bool AddressBook::applyRemove(const QString& label, const QString& address) {
+    auto existing = addressByLabel.constFind(label);
+    if (existing == addressByLabel.constEnd() || existing.value() != address)
+        return false;
 
-// Add a new address/label to the database
-void AddressBook::addAddressLabel(QString label, QString address) {
+    ordered.remove(positionByLabel.take(label));
+    allLabelsDirty = true;
+    addressByLabel.remove(label);
 
-    // First, remove any existing label
-    // Iterate over the list and remove the label/address
-    for (int i=0; i < allLabels.size(); i++) {
-        if (allLabels[i].first == label) {
-            removeAddressLabel(allLabels[i].first, allLabels[i].second);
-        }
+    auto labels = labelsByAddress.find(address);
+    if (labels != labelsByAddress.end()) {
+        labels->removeOne(label);
+        if (labels->isEmpty())
+            labelsByAddress.erase(labels);
     }
 
-    allLabels.push_back(QPair<QString, QString>(label, address));
-    writeToStorage();
+    return true;
+}
+
+bool AddressBook::applyUpdate(const QString& oldlabel, const QString& address, const QString& newlabel) {
+    auto existing = addressByLabel.constFind(oldlabel);
+    if (existing == addressByLabel.constEnd() || existing.value() != address)
+        return false;
+
+    if (oldlabel == newlabel)
+        return true;
+
+    // The new label might already belong to some other address
+    auto other = addressByLabel.constFind(newlabel);
+    if (other != addressByLabel.constEnd()) {
+        applyRemove(newlabel, other.value());
+    }
+
+    // Update in place, so the label keeps its position
+    qint64 pos = positionByLabel.take(oldlabel);
+    ordered[pos].first = newlabel;
+    positionByLabel.insert(newlabel, pos);
+    allLabelsDirty = true;
+
+    addressByLabel.remove(oldlabel);
+    addressByLabel.insert(newlabel, address);
+
+    auto& labels = labelsByAddress[address];
+    int lpos = labels.indexOf(oldlabel);
+    if (lpos >= 0)
+        labels[lpos] = newlabel;
+
+    return true;
+}
+
+// Add a new address/label to the database
+void AddressBook::addAddressLabel(QString label, QString address) {
+    applyAdd(label, address);
+    WalletStore::getInstance()->put(storeNamespace, label, address.toUtf8());
 }
 
 // Remove a new address/label from the database
 void AddressBook::removeAddressLabel(QString label, QString address) {
-    // Iterate over the list and remove the label/address
-    for (int i=0; i < allLabels.size(); i++) {
-        if (allLabels[i].first == label && allLabels[i].second == address) {
-            allLabels.removeAt(i);
-            writeToStorage();
-            return;
-        }
-    }
+    if (applyRemove(label, address))
+        WalletStore::getInstance()->remove(storeNamespace, label);
 }
 
 void AddressBook::updateLabel(QString oldlabel, QString address, QString newlabel) {
-    // Iterate over the list and update the label/address
-    for (int i = 0; i < allLabels.size(); i++) {
-        if (allLabels[i].first == oldlabel && allLabels[i].second == address) {
-            allLabels[i].first = newlabel;
-            writeToStorage();
-            return;
-        }
+    if (applyUpdate(oldlabel, address, newlabel) && oldlabel != newlabel) {
+        auto store = WalletStore::getInstance();
+        store->remove(storeNamespace, oldlabel);
+        store->put(storeNamespace, newlabel, address.toUtf8());
     }
 }
 
 // Read all addresses
 const QList<QPair<QString, QString>>& AddressBook::getAllAddressLabels() {
-    if (allLabels.isEmpty()) {
+    if (ordered.isEmpty()) {
         readFromStorage();
     }
+
+    if (allLabelsDirty) {
+        allLabels = ordered.values();
+        allLabelsDirty = false;
+    }
     return allLabels;
 }
 
-// Get the label for an address
+// Get the label for an address. This is called for every address cell that is painted, so it has to be fast.
 QString AddressBook::getLabelForAddress(QString addr) {
-    for (auto i : allLabels) {
-        if (i.second == addr)
-            return i.first;
-    }
+    auto labels = labelsByAddress.constFind(addr);
+    if (labels == labelsByAddress.constEnd() || labels->isEmpty())
+        return "";
 
-    return "";
+    return labels->first();
 }
 
 QString AddressBook::addLabelToAddress(QString addr) {
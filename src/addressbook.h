@@ -12,6 +12,7 @@ public:
     ~AddressBookModel();
 
     void addNewLabel(QString label, QString addr);
+    void addNewLabels(const QList<QPair<QString, QString>>& newLabels);
     void removeItemAt(int row);
     QPair<QString, QString> itemAt(int row);
 
@@ -56,10 +57,26 @@ private:
     AddressBook();
 
     void readFromStorage();
-    void writeToStorage();
+    void migrateFromFiles();
+
+    // Change the in-memory data and indexes, without touching the disk
+    void applyAdd   (const QString& label, const QString& address);
+    bool applyRemove(const QString& label, const QString& address);
+    bool applyUpdate(const QString& oldlabel, const QString& address, const QString& newlabel);
 
     QString writeableFile();
+
+    // Labels in the order they were added, keyed by a sequence number, so a label can be removed
+    // or renamed in place without scanning for it. allLabels is rebuilt from it when it is read.
+    QMap<qint64, QPair<QString, QString>> ordered;
+    QHash<QString, qint64>         positionByLabel;
+    qint64                         nextPosition     = 0;
+
     QList<QPair<QString, QString>> allLabels;
+    bool                           allLabelsDirty   = false;
+
+    QHash<QString, QString>        addressByLabel;      // Labels are unique
+    QHash<QString, QStringList>    labelsByAddress;     // In the order they were added
 
     static AddressBook* instance;
 };
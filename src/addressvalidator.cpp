@@ -0,0 +1,236 @@
+#include "addressvalidator.h"
+
+// Value of each character in Base58, or -1
+static const qint8 base58Digits[128] = {
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1,  0,  1,  2,  3,  4,  5,  6,  7,  8, -1, -1, -1, -1, -1, -1,
+    -1,  9, 10, 11, 12, 13, 14, 15, 16, -1, 17, 18, 19, 20, 21, -1,
+    22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, -1, -1, -1, -1, -1,
+    -1, 33, 34, 35, 36, 37, 38, 39, 40, 41, 42, 43, -1, 44, 45, 46,
+    47, 48, 49, 50, 51, 52, 53, 54, 55, 56, 57, -1, -1, -1, -1, -1,
+};
+
+// Value of each character in Bech32 (either case), or -1
+static const qint8 bech32Digits[128] = {
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    15, -1, 10, 17, 21, 20, 26, 30,  7,  5, -1, -1, -1, -1, -1, -1,
+    -1, 29, -1, 24, 13, 25,  9,  8, 23, -1, 18, 22, 31, 27, 19, -1,
+     1,  0,  3, 16, 11, 28, 12, 14,  6,  4,  2, -1, -1, -1, -1, -1,
+    -1, 29, -1, 24, 13, 25,  9,  8, 23, -1, 18, 22, 31, 27, 19, -1,
+     1,  0,  3, 16, 11, 28, 12, 14,  6,  4,  2, -1, -1, -1, -1, -1,
+};
+
+// Encoded and decoded lengths of each kind of address
+static const int tAddrLength        = 35;
+static const int tAddrBytes         = 26;   // 2 byte prefix, 20 byte hash, 4 byte checksum
+static const int sproutLength       = 95;
+static const int sproutBytes        = 70;   // 2 byte prefix, 64 byte payload, 4 byte checksum
+static const int saplingDataLength  = 75;   // 43 byte payload in 69 characters, and a 6 character checksum
+
+//=================================
+// SHA-256, just enough for the 4 byte Base58Check checksum
+//=================================
+static const quint32 sha256K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static inline quint32 rotr(quint32 x, int n) { return (x >> n) | (x << (32 - n)); }
+
+static void sha256Block(quint32 h[8], const uchar* block) {
+    quint32 w[64];
+    for (int i = 0; i < 16; i++) {
+        w[i] = qFromBigEndian<quint32>(block + i * 4);
+    }
+    for (int i = 16; i < 64; i++) {
+        quint32 s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        quint32 s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19)  ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    quint32 a = h[0], b = h[1], c = h[2], d = h[3], e = h[4], f = h[5], g = h[6], k = h[7];
+    for (int i = 0; i < 64; i++) {
+        quint32 t1 = k + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + sha256K[i] + w[i];
+        quint32 t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        k = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+
+    h[0] += a; h[1] += b; h[2] += c; h[3] += d;
+    h[4] += e; h[5] += f; h[6] += g; h[7] += k;
+}
+
+// The input is at most 66 bytes, so it always fits in two blocks
+static void sha256(const uchar* data, int length, uchar out[32]) {
+    quint32 h[8] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                     0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+
+    uchar blocks[128] = {0};
+    memcpy(blocks, data, length);
+    blocks[length] = 0x80;
+
+    int total = length + 9 <= 64 ? 64 : 128;
+    qToBigEndian<quint64>((quint64)length * 8, blocks + total - 8);
+
+    for (int i = 0; i < total; i += 64) {
+        sha256Block(h, blocks + i);
+    }
+    for (int i = 0; i < 8; i++) {
+        qToBigEndian<quint32>(h[i], out + i * 4);
+    }
+}
+
+//=================================
+// Base58Check and Bech32
+//=================================
+bool AddressValidator::checkBase58(const QChar* s, int length, int decodedLength) {
+    uchar bytes[sproutBytes] = {0};
+    uchar* out = bytes + sproutBytes - decodedLength;
+
+    int leadingOnes = 0;
+    while (leadingOnes < length && s[leadingOnes] == '1')
+        leadingOnes++;
+
+    // Big number multiply and add, into a buffer exactly as long as the decoded address
+    for (int i = 0; i < length; i++) {
+        ushort c = s[i].unicode();
+        int digit = c < 128 ? base58Digits[c] : -1;
+        if (digit < 0)
+            return false;
+
+        quint32 carry = digit;
+        for (int j = decodedLength - 1; j >= 0; j--) {
+            carry += 58 * (quint32)out[j];
+            out[j] = carry & 0xff;
+            carry >>= 8;
+        }
+        if (carry != 0)
+            return false;   // Too long
+    }
+
+    // Each leading '1' is a leading zero byte. Any other leading zeros mean the address is too short.
+    int leadingZeros = 0;
+    while (leadingZeros < decodedLength && out[leadingZeros] == 0)
+        leadingZeros++;
+    if (leadingZeros != leadingOnes)
+        return false;
+
+    uchar hash[32];
+    sha256(out, decodedLength - 4, hash);
+    sha256(hash, 32, hash);
+
+    return memcmp(hash, out + decodedLength - 4, 4) == 0;
+}
+
+bool AddressValidator::checkBech32(const QChar* s, int length, int hrpLength) {
+    static const quint32 generator[5] = { 0x3b6a57b2, 0x26508e6d, 0x1ea119fa, 0x3d4233dd, 0x2a1462b3 };
+
+    auto step = [=] (quint32 chk, int value) {
+        quint32 top = chk >> 25;
+        chk = ((chk & 0x1ffffff) << 5) ^ value;
+        for (int i = 0; i < 5; i++) {
+            if ((top >> i) & 1)
+                chk ^= generator[i];
+        }
+        return chk;
+    };
+
+    if (s[hrpLength] != '1')
+        return false;
+
+    // The hrp is already known to be one of ours, so it's only lowercased here for the checksum. Its
+    // case still counts towards mixed case, like the data's.
+    bool hasLower = false, hasUpper = false;
+    quint32 chk = 1;
+    for (int i = 0; i < hrpLength; i++) {
+        ushort c = s[i].unicode();
+        hasLower = hasLower || (c >= 'a' && c <= 'z');
+        hasUpper = hasUpper || (c >= 'A' && c <= 'Z');
+
+        chk = step(chk, s[i].toLower().unicode() >> 5);
+    }
+    chk = step(chk, 0);
+    for (int i = 0; i < hrpLength; i++) {
+        chk = step(chk, s[i].toLower().unicode() & 31);
+    }
+
+    int last = 0;
+    for (int i = hrpLength + 1; i < length; i++) {
+        ushort c = s[i].unicode();
+        int value = c < 128 ? bech32Digits[c] : -1;
+        if (value < 0)
+            return false;
+
+        hasLower = hasLower || (c >= 'a' && c <= 'z');
+        hasUpper = hasUpper || (c >= 'A' && c <= 'Z');
+        if (i == length - 7)
+            last = value;
+
+        chk = step(chk, value);
+    }
+
+    // Mixed case isn't allowed, and the bit of padding after the 43 byte payload has to be 0
+    return !(hasLower && hasUpper) && (last & 1) == 0 && chk == 1;
+}
+
+AddressValidator::Type AddressValidator::classify(const QString& addr) {
+    const QChar* s = addr.constData();
+    int length     = addr.length();
+
+    if (length == tAddrLength && s[0] == 't') {
+        return checkBase58(s, length, tAddrBytes) ? Transparent : Invalid;
+    }
+
+    if (length == sproutLength && s[0] == 'z') {
+        return checkBase58(s, length, sproutBytes) ? Sprout : Invalid;
+    }
+
+    for (auto hrp : { QLatin1String("zs"), QLatin1String("ztestsapling") }) {
+        if (length == hrp.size() + 1 + saplingDataLength && addr.startsWith(hrp, Qt::CaseInsensitive)) {
+            return checkBech32(s, length, hrp.size()) ? Sapling : Invalid;
+        }
+    }
+
+    return Invalid;
+}
+
+QVector<AddressValidator::Type> AddressValidator::classify(const QStringList& addrs) {
+    QVector<Type> types(addrs.size());
+    Type* out = types.data();
+
+    auto fnClassifyRange = [&] (int start, int end) {
+        for (int i = start; i < end; i++) {
+            out[i] = classify(addrs[i]);
+        }
+    };
+
+    if (addrs.size() <= batchChunkSize) {
+        fnClassifyRange(0, addrs.size());
+        return types;
+    }
+
+    int threads   = qMax(1, qMin(QThread::idealThreadCount(), (addrs.size() + batchChunkSize - 1) / batchChunkSize));
+    int chunkSize = (addrs.size() + threads - 1) / threads;
+
+    std::vector<std::future<void>> workers;
+    for (int start = chunkSize; start < addrs.size(); start += chunkSize) {
+        workers.push_back(std::async(std::launch::async, fnClassifyRange, start, qMin(start + chunkSize, addrs.size())));
+    }
+    fnClassifyRange(0, qMin(chunkSize, addrs.size()));
+
+    for (auto& w : workers) {
+        w.wait();
+    }
+
+    return types;
+}
@@ -0,0 +1,36 @@
+#ifndef ADDRESSVALIDATOR_H
+#define ADDRESSVALIDATOR_H
+
+#include "precompiled.h"
+
+/**
+ * Checks addresses the way commerciumd does, including the checksum, so a typo is caught before
+ * z_sendmany. t-Addrs and Sprout z-Addrs are Base58Check, Sapling z-Addrs are Bech32. Nothing is
+ * allocated, so this is cheap enough to run on every keystroke.
+ */
+class AddressValidator {
+public:
+    enum Type {
+        Invalid = 0,
+        Transparent,
+        Sprout,
+        Sapling
+    };
+
+    static Type             classify(const QString& addr);
+    static bool             isValid(const QString& addr) { return classify(addr) != Invalid; }
+
+    // Bech32 can be all uppercase (eg. from a QR code), but the rest of the wallet expects lowercase
+    static QString          normalize(const QString& addr) { return classify(addr) == Sapling ? addr.toLower() : addr; }
+
+    // Classify a whole list at once, like an imported address book. Large lists are split across threads.
+    static QVector<Type>    classify(const QStringList& addrs);
+
+private:
+    static bool             checkBase58(const QChar* s, int length, int decodedLength);
+    static bool             checkBech32(const QChar* s, int length, int hrpLength);
+
+    static const int        batchChunkSize  = 1024;
+};
+
+#endif // ADDRESSVALIDATOR_H
@@ -3,6 +3,11 @@
 #include "settings.h"
 #include "ui_connection.h"
 #include "rpc.h"
+#include "ioexecutor.h"
+#include "paramsdownloader.h"
+#include "paramsverifier.h"
+#include "daemonstartup.h"
+#include "daemontuning.h"
 
 #include "precompiled.h"
 
@@ -17,9 +22,21 @@ ConnectionLoader::ConnectionLoader(MainWindow* main, RPC* rpc) {
     connD->setupUi(d);
     QPixmap logo(":/img/res/logobig.gif");
     connD->topIcon->setBasePixmap(logo.scaled(256, 256, Qt::KeepAspectRatio, Qt::SmoothTransformation));
+
+    probeTimer = new QTimer();
+    probeTimer->setSingleShot(true);
+    QObject::connect(probeTimer, &QTimer::timeout, [=] () {
+        auto probe = pendingProbe;
+        probe();
+    });
 }
 
 ConnectionLoader::~ConnectionLoader() {    
+    // The embedded commerciumd outlives this, so stop it calling back
+    if (startup != nullptr)
+        startup->stop();
+
+    delete probeTimer;
     delete d;
     delete connD;
 }
@@ -31,14 +48,15 @@ void ConnectionLoader::loadConnection() {
 
 void ConnectionLoader::doAutoConnect(bool tryEcommerciumdStart) {
     // Priority 1: Ensure all params are present.
-    if (!verifyParams()) {
+    if (!paramsVerified && !verifyParams()) {
         downloadParams([=]() { this->doAutoConnect(); });
         return;
     }
+    paramsVerified = true;
 
     // Priority 2: Try to connect to detect commercium.conf and connect to it.
     auto config = autoDetectCommerciumConf();
-    main->logger->write(QObject::tr("Attempting autoconnect"));
+    LOG(main->logger, Info, Connection, QObject::tr("Attempting autoconnect"));
 
     if (config.get() != nullptr) {
         auto connection = makeConnection(config);
@@ -49,27 +67,27 @@ void ConnectionLoader::doAutoConnect(bool tryEcommerciumdStart) {
                 if (tryEcommerciumdStart) {
                     this->showInformation(QObject::tr("Starting embedded commerciumd"));
                     if (this->startEmbeddedCommerciumd()) {
-                        // Embedded commerciumd started up. Wait a second and then refresh the connection
-                        main->logger->write("Embedded commerciumd started up, trying autoconnect in 1 sec");
-                        QTimer::singleShot(1000, [=]() { doAutoConnect(); } );
+                        // Embedded commerciumd started up. Try again shortly, or as soon as it says it's ready
+                        LOG(main->logger, Info, Daemon, "Embedded commerciumd started up, trying autoconnect in " + QString::number(probeDelay) + " ms");
+                        scheduleProbe([=]() { doAutoConnect(); });
                     } else {
                         if (config->commerciumDaemon) {
                             // commerciumd is configured to run as a daemon, so we must wait for a few seconds
                             // to let it start up. 
-                            main->logger->write("commerciumd is daemon=1. Waiting for it to start up");
+                            LOG(main->logger, Info, Daemon, "commerciumd is daemon=1. Waiting for it to start up");
                             this->showInformation(QObject::tr("commerciumd is set to run as daemon"), QObject::tr("Waiting for commerciumd"));
                             QTimer::singleShot(5000, [=]() { doAutoConnect(/* don't attempt to start ecommerciumd */ false); });
                         } else {
                             // Something is wrong. 
                             // We're going to attempt to connect to the one in the background one last time
                             // and see if that works, else throw an error
-                            main->logger->write("Unknown problem while trying to start commerciumd");
+                            LOG(main->logger, Error, Daemon, "Unknown problem while trying to start commerciumd");
                             QTimer::singleShot(2000, [=]() { doAutoConnect(/* don't attempt to start ecommerciumd */ false); });
                         }
                     }
                 } else {
                     // We tried to start ecommerciumd previously, and it didn't work. So, show the error. 
-                    main->logger->write("Couldn't start embedded commerciumd for unknown reason");
+                    LOG(main->logger, Error, Daemon, "Couldn't start embedded commerciumd for unknown reason");
                     QString explanation;
                     if (config->commerciumDaemon) {
                         explanation = QString() % QObject::tr("You have commerciumd set to start as a daemon, which can cause problems "
@@ -87,7 +105,7 @@ void ConnectionLoader::doAutoConnect(bool tryEcommerciumdStart) {
                 }                
             } else {
                 // commercium.conf exists, there's no connection, and the user asked us not to start commerciumd. Error!
-                main->logger->write("Not using embedded and couldn't connect to commerciumd");
+                LOG(main->logger, Error, Connection, "Not using embedded and couldn't connect to commerciumd");
                 QString explanation = QString() % QObject::tr("Couldn't connect to commerciumd configured in commercium.conf.\n\n" 
                                       "Not starting embedded commerciumd because --no-embedded was passed");
                 this->showError(explanation);
@@ -125,17 +143,17 @@ QString randomPassword() {
  * This will create a new commercium.conf, download Commercium parameters.
  */ 
 void ConnectionLoader::createCommerciumConf() {
-    main->logger->write("createCommerciumConf");
+    LOG(main->logger, Debug, Connection, "createCommerciumConf");
 
     auto confLocation = commerciumConfWritableLocation();
-    main->logger->write("Creating file " + confLocation);
+    LOG(main->logger, Info, Connection, "Creating file " + confLocation);
 
     QFileInfo fi(confLocation);
     QDir().mkdir(fi.dir().absolutePath());
 
     QFile file(confLocation);
     if (!file.open(QIODevice::ReadWrite | QIODevice::Truncate)) {
-        main->logger->write("Could not create commercium.conf, returning");
+        LOG(main->logger, Error, Connection, "Could not create commercium.conf, returning");
         return;
     }
         
@@ -148,76 +166,71 @@ void ConnectionLoader::createCommerciumConf() {
     out << "rpcpassword=" % randomPassword() << "\n";
     file.close();
 
+    // Size the caches and threads for this computer
+    auto hw     = DaemonTuning::detect(fi.dir().absolutePath());
+    auto tuning = DaemonTuning::propose(hw);
+    LOG(main->logger, Info, Connection, "Tuning commercium.conf for " + QString::number(hw.cores) + " cores and " + 
+                                        QString::number(hw.ramBytes / (1024 * 1024)) + " MB: dbcache=" + QString::number(tuning.dbcache) + 
+                                        " par=" + QString::number(tuning.par) + " maxconnections=" + QString::number(tuning.maxconnections));
+    DaemonTuning::apply(confLocation, tuning);
+
     // Now that commercium.conf exists, try to autoconnect again
     this->doAutoConnect();
 }
 
 
-void ConnectionLoader::downloadParams(std::function<void(void)> cb) {    
-    main->logger->write("Adding params to download queue");
-    // Add all the files to the download queue
-    downloadQueue = new QQueue<QUrl>();
-    client = new QNetworkAccessManager(main);   
-    
-    downloadQueue->enqueue(QUrl("https://z.cash/downloads/sapling-output.params"));
-    downloadQueue->enqueue(QUrl("https://z.cash/downloads/sapling-spend.params"));    
-    downloadQueue->enqueue(QUrl("https://z.cash/downloads/sprout-proving.key"));
-    downloadQueue->enqueue(QUrl("https://z.cash/downloads/sprout-verifying.key"));
-    downloadQueue->enqueue(QUrl("https://z.cash/downloads/sprout-groth16.params"));
-
-    doNextDownload(cb);    
-}
-
-void ConnectionLoader::doNextDownload(std::function<void(void)> cb) {
-    auto fnSaveFileName = [&] (QUrl url) {
-        QString path = url.path();
-        QString basename = QFileInfo(path).fileName();
-
-        return basename;
-    };
+/**
+ * Params that are already there but haven't been verified (say, fetched by commercium-fetch-params) are
+ * hashed first. The ones that are wrong are deleted, and then everything that's missing is downloaded.
+ */
+void ConnectionLoader::downloadParams(std::function<void(void)> cb) {
+    QString paramsDir = commerciumParamsDir();
 
-    if (downloadQueue->isEmpty()) {
-        delete downloadQueue;
-        client->deleteLater();
+    QStringList unverified;
+    for (const auto& name : ParamsVerifier::fileNames()) {
+        if (QFile::exists(QDir(paramsDir).filePath(name)) && !ParamsVerifier::isStamped(paramsDir, name))
+            unverified.push_back(name);
+    }
 
-        main->logger->write("All Downloads done");
-        this->showInformation(QObject::tr("All Downloads Finished Successfully!"));
-        cb();
+    if (unverified.isEmpty()) {
+        doDownloadParams(cb);
         return;
     }
 
-    QUrl url = downloadQueue->dequeue();
-    int filesRemaining = downloadQueue->size();
-
-    QString filename = fnSaveFileName(url);
-    QString paramsDir = commerciumParamsDir();
+    LOG(main->logger, Info, Params, "Verifying " + unverified.join(", "));
+    this->showInformation(QObject::tr("Verifying params"), QObject::tr("This may take a minute"));
 
-    if (QFile(QDir(paramsDir).filePath(filename)).exists()) {
-        main->logger->write(filename + " already exists, skipping");
-        doNextDownload(cb);
+    auto bad = std::make_shared<QStringList>();
+    IOExecutor::getInstance()->runAside([=] () {
+        *bad = ParamsVerifier::verify(paramsDir, unverified);
+        for (const auto& name : *bad) {
+            QFile::remove(QDir(paramsDir).filePath(name));
+        }
+    }, [=] () {
+        for (const auto& name : *bad) {
+            LOG(main->logger, Warning, Params, name + " is corrupt, downloading it again");
+        }
+        doDownloadParams(cb);
+    });
+}
 
-        return;
-    }
+void ConnectionLoader::doDownloadParams(std::function<void(void)> cb) {
+    LOG(main->logger, Info, Params, "Adding params to download queue");
+    QList<QUrl> urls = {
+        QUrl("https://z.cash/downloads/sapling-output.params"),
+        QUrl("https://z.cash/downloads/sapling-spend.params"),
+        QUrl("https://z.cash/downloads/sprout-proving.key"),
+        QUrl("https://z.cash/downloads/sprout-verifying.key"),
+        QUrl("https://z.cash/downloads/sprout-groth16.params")
+    };
 
-    // The downloaded file is written to a new name, and then renamed when the operation completes.
-    currentOutput = new QFile(QDir(paramsDir).filePath(filename + ".part"));   
+    auto snap = Settings::getInstance()->snapshot();
+    auto downloader = new ParamsDownloader(main, commerciumParamsDir(), urls, snap->paramDownloads, snap->paramSegments);
 
-    if (!currentOutput->open(QIODevice::WriteOnly)) {
-        main->logger->write("Couldn't open " + currentOutput->fileName() + " for writing");
-        this->showError(QObject::tr("Couldn't download params. Please check the help site for more info."));
-    }
-    main->logger->write("Downloading to " + filename);
-    qDebug() << "Downloading " << url << " to " << filename;
-    
-    QNetworkRequest request(url);
-    request.setAttribute(QNetworkRequest::FollowRedirectsAttribute, true);
-    currentDownload = client->get(request);
-    downloadTime.start();
-    
     // Download Progress
-    QObject::connect(currentDownload, &QNetworkReply::downloadProgress, [=] (auto done, auto total) {
+    downloader->start([=] (const ParamsDownloader::Progress& p) {
         // calculate the download speed
-        double speed = done * 1000.0 / downloadTime.elapsed();
+        double speed = p.bytesPerSec;
         QString unit;
         if (speed < 1024) {
             unit = "bytes/sec";
@@ -230,39 +243,30 @@ void ConnectionLoader::doNextDownload(std::function<void(void)> cb) {
         }
 
         this->showInformation(
-            QObject::tr("Downloading ") % filename % (filesRemaining > 1 ? " ( +" % QString::number(filesRemaining)  % QObject::tr(" more remaining )") : QString("")),
-            QString::number(done/1024/1024, 'f', 0) % QObject::tr("MB of ") % QString::number(total/1024/1024, 'f', 0) + QObject::tr("MB at ") % QString::number(speed, 'f', 2) % unit);
-    });
-    
-    // Download Finished
-    QObject::connect(currentDownload, &QNetworkReply::finished, [=] () {
-        // Rename file
-        main->logger->write("Finished downloading " + filename);
-        currentOutput->rename(QDir(paramsDir).filePath(filename));
-
-        currentOutput->close();
-        currentDownload->deleteLater();
-        currentOutput->deleteLater();
-
-        if (currentDownload->error()) {
-            main->logger->write("Downloading " + filename + " failed");
-            this->showError(QObject::tr("Downloading ") + filename + QObject::tr(" failed. Please run commercium-fetch-params."));                
-        } else {
-            doNextDownload(cb);
+            QObject::tr("Downloading params") % (p.filesRemaining > 1 ? " ( " % QString::number(p.filesRemaining)  % QObject::tr(" files remaining )") : QString("")),
+            QString::number(p.done/1024/1024) % QObject::tr("MB of ") % QString::number(p.total/1024/1024) + QObject::tr("MB at ") % QString::number(speed, 'f', 2) % unit);
+    }, [=] (QString error) {
+        downloader->deleteLater();
+
+        if (!error.isEmpty()) {
+            LOG(main->logger, Error, Params, "Downloading params failed: " + error);
+            this->showError(error % "\n" % QObject::tr("Downloading params failed. Please run commercium-fetch-params."));
+            return;
         }
-    });
 
-    // Download new data available. 
-    QObject::connect(currentDownload, &QNetworkReply::readyRead, [=] () {
-        currentOutput->write(currentDownload->readAll());
-    });    
+        // Everything has been checked now, even if the stamps couldn't be written
+        LOG(main->logger, Info, Params, "All Downloads done");
+        this->showInformation(QObject::tr("All Downloads Finished Successfully!"));
+        paramsVerified = true;
+        cb();
+    });
 }
 
 bool ConnectionLoader::startEmbeddedCommerciumd() {
     if (!Settings::getInstance()->useEmbedded()) 
         return false;
     
-    main->logger->write("Trying to start embedded commerciumd");
+    LOG(main->logger, Info, Daemon, "Trying to start embedded commerciumd");
 
     // Static because it needs to survive even after this method returns.
     static QString processStdErrOutput;
@@ -294,7 +298,7 @@ bool ConnectionLoader::startEmbeddedCommerciumd() {
     
     if (!QFile(commerciumdProgram).exists()) {
         qDebug() << "Can't find commerciumd at " << commerciumdProgram;
-        main->logger->write("Can't find commerciumd at " + commerciumdProgram); 
+        LOG(main->logger, Error, Daemon, "Can't find commerciumd at " + commerciumdProgram); 
         return false;
     }
 
@@ -312,10 +316,38 @@ bool ConnectionLoader::startEmbeddedCommerciumd() {
         //qDebug() << "Couldn't start commerciumd: " << error;
     });
 
-    QObject::connect(ecommerciumd, &QProcess::readyReadStandardError, [=]() {
-        auto output = ecommerciumd->readAllStandardError();
-       main->logger->write("commerciumd stderr:" + output);
+    // Follow what commerciumd is doing, and try the RPC as soon as it says it's done loading
+    startup = new DaemonStartup(ecommerciumd, commerciumDebugLogLocation());
+    startup->setCallback([=] (DaemonStartup::Phase phase, int percent, QString message) {
+        LOG(main->logger, Info, Daemon, "Startup: " + message + " (" + QString::number(percent) + "%)");
+        this->showInformation(QObject::tr("Your commerciumd is starting up. Please wait."), message);
+        connD->startupProgress->setVisible(true);
+        connD->startupProgress->setValue(percent);
+
+        if (phase == DaemonStartup::Ready)
+            probeNow();
+    });
+
+    // These outlive this ConnectionLoader, so they don't use its members
+    auto process = ecommerciumd;
+    auto monitor = startup;
+    auto logger  = main->logger;
+    QObject::connect(ecommerciumd, &QProcess::readyReadStandardOutput, monitor, [=]() {
+        monitor->addOutput(DaemonStartup::Stdout, process->readAllStandardOutput());
+    });
+
+    QObject::connect(ecommerciumd, &QProcess::readyReadStandardError, monitor, [=]() {
+        auto output = process->readAllStandardError();
+
+        // commerciumd writes its ordinary progress to stderr too
+        auto lower = output.toLower();
+        if (lower.contains("error") || lower.contains("exception")) {
+            LOG(logger, Warning, Daemon, "commerciumd stderr:" + output);
+        } else {
+            LOG(logger, Info, Daemon, "commerciumd stderr:" + output);
+        }
         processStdErrOutput.append(output);
+        monitor->addOutput(DaemonStartup::Stderr, output);
     });
 
 #ifdef Q_OS_LINUX
@@ -407,7 +439,7 @@ void ConnectionLoader::refreshCommerciumdState(Connection* connection, std::func
             if (err == QNetworkReply::NetworkError::ConnectionRefusedError) {   
                 refused();
             } else if (err == QNetworkReply::NetworkError::AuthenticationRequiredError) {
-                main->logger->write("Authentication failed");
+                LOG(main->logger, Error, Connection, "Authentication failed");
                 QString explanation = QString() % 
                         QObject::tr("Authentication failed. The username / password you specified was "
                         "not accepted by commerciumd. Try changing it in the Edit->Settings menu");
@@ -415,24 +447,42 @@ void ConnectionLoader::refreshCommerciumdState(Connection* connection, std::func
                 this->showError(explanation);
             } else if (err == QNetworkReply::NetworkError::InternalServerError && 
                     !res.is_discarded()) {
-                // The server is loading, so just poll until it succeeds
-                QString status    = QString::fromStdString(res["error"]["message"]);
-                {
-                    static int dots = 0;
-                    status = status.left(status.length() - 3) + QString(".").repeated(dots);
-                    dots++;
-                    if (dots > 3)
-                        dots = 0;
+                // The server is loading, so just poll until it succeeds. The embedded commerciumd's
+                // own output says more than the RPC error, once there is any.
+                if (startup == nullptr || startup->getPhase() == DaemonStartup::Starting) {
+                    QString status    = QString::fromStdString(res["error"]["message"]);
+                    {
+                        static int dots = 0;
+                        status = status.left(status.length() - 3) + QString(".").repeated(dots);
+                        dots++;
+                        if (dots > 3)
+                            dots = 0;
+                    }
+                    this->showInformation(QObject::tr("Your commerciumd is starting up. Please wait."), status);
                 }
-                this->showInformation(QObject::tr("Your commerciumd is starting up. Please wait."), status);
-                main->logger->write("Waiting for commerciumd to come online.");
-                // Refresh after one second
-                QTimer::singleShot(1000, [=]() { this->refreshCommerciumdState(connection, refused); });
+                LOG(main->logger, Info, Connection, "Waiting for commerciumd to come online.");
+                scheduleProbe([=]() { this->refreshCommerciumdState(connection, refused); });
             }
         }
     );
 }
 
+// Run the probe after the current delay, and double the delay for next time
+void ConnectionLoader::scheduleProbe(std::function<void(void)> probe) {
+    pendingProbe = probe;
+    probeTimer->start(probeDelay);
+    probeDelay = qMin(probeDelay * 2, (int)maxProbeDelay);
+}
+
+// Run the waiting probe right away, because commerciumd said it's ready
+void ConnectionLoader::probeNow() {
+    probeDelay = minProbeDelay;
+    if (probeTimer->isActive()) {
+        probeTimer->stop();
+        pendingProbe();
+    }
+}
+
 void ConnectionLoader::showInformation(QString info, QString detail) {
     connD->status->setText(info);
     connD->statusDetail->setText(detail);
@@ -458,7 +508,7 @@ QString ConnectionLoader::locateCommerciumConfFile() {
     auto confLocation = QStandardPaths::locate(QStandardPaths::AppDataLocation, "../../Commercium/commercium.conf");
 #endif
 
-    main->logger->write("Found commerciumconf at " + QDir::cleanPath(confLocation));
+    LOG(main->logger, Info, Connection, "Found commerciumconf at " + QDir::cleanPath(confLocation));
     return QDir::cleanPath(confLocation);
 }
 
@@ -471,36 +521,53 @@ QString ConnectionLoader::commerciumConfWritableLocation() {
     auto confLocation = QDir(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)).filePath("../../Commercium/commercium.conf");
 #endif
 
-    main->logger->write("Found commerciumconf at " + QDir::cleanPath(confLocation));
+    LOG(main->logger, Info, Connection, "Found commerciumconf at " + QDir::cleanPath(confLocation));
     return QDir::cleanPath(confLocation);
 }
 
+// The embedded commerciumd uses the writable commercium.conf, and keeps a testnet's debug.log in testnet3
+QString ConnectionLoader::commerciumDebugLogLocation() {
+    auto confLocation = commerciumConfWritableLocation();
+    QDir dataDir = QFileInfo(confLocation).absoluteDir();
+
+    QFile file(confLocation);
+    if (file.open(QIODevice::ReadOnly)) {
+        QTextStream in(&file);
+        while (!in.atEnd()) {
+            QString line = in.readLine();
+            auto s = line.indexOf("=");
+            QString name  = line.left(s).trimmed().toLower();
+            QString value = line.right(line.length() - s - 1).trimmed();
+
+            if (name == "testnet" && value == "1") {
+                return dataDir.filePath("testnet3/debug.log");
+            }
+        }
+    }
+
+    return dataDir.filePath("debug.log");
+}
+
 QString ConnectionLoader::commerciumParamsDir() {
-    #ifdef Q_OS_LINUX
-    auto paramsLocation = QDir(QDir(QStandardPaths::writableLocation(QStandardPaths::HomeLocation)).filePath(".zcash-params"));
-#elif defined(Q_OS_DARWIN)
-    auto paramsLocation = QDir(QDir(QStandardPaths::writableLocation(QStandardPaths::HomeLocation)).filePath("Library/Application Support/ZcashParams"));
-#else
-    auto paramsLocation = QDir(QDir(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)).filePath("../../ZcashParams"));
-#endif
+    auto paramsLocation = QDir(ParamsVerifier::paramsLocation());
 
     if (!paramsLocation.exists()) {
-        main->logger->write("Creating params location at " + paramsLocation.absolutePath());
+        LOG(main->logger, Info, Params, "Creating params location at " + paramsLocation.absolutePath());
         QDir().mkpath(paramsLocation.absolutePath());
     }
 
-    main->logger->write("Found Commercium params directory at " + paramsLocation.absolutePath());
+    LOG(main->logger, Info, Params, "Found Commercium params directory at " + paramsLocation.absolutePath());
     return paramsLocation.absolutePath();
 }
 
+// All the params have to be there, and have been checked against their digests since they last changed
 bool ConnectionLoader::verifyParams() {
-    QDir paramsDir(commerciumParamsDir());
+    QString paramsDir = commerciumParamsDir();
 
-    if (!QFile(paramsDir.filePath("sapling-output.params")).exists()) return false;
-    if (!QFile(paramsDir.filePath("sapling-spend.params")).exists()) return false;
-    if (!QFile(paramsDir.filePath("sprout-proving.key")).exists()) return false;
-    if (!QFile(paramsDir.filePath("sprout-verifying.key")).exists()) return false;
-    if (!QFile(paramsDir.filePath("sprout-groth16.params")).exists()) return false;
+    for (const auto& name : ParamsVerifier::fileNames()) {
+        if (!ParamsVerifier::isStamped(paramsDir, name))
+            return false;
+    }
 
     return true;
 }
@@ -574,13 +641,12 @@ std::shared_ptr<ConnectionConfig> ConnectionLoader::autoDetectCommerciumConf() {
  * Load connection settings from the UI, which indicates an unknown, external commerciumd
  */ 
 std::shared_ptr<ConnectionConfig> ConnectionLoader::loadFromSettings() {
-    // Load from the QT Settings. 
-    QSettings s;
-    
-    auto host        = s.value("connection/host").toString();
-    auto port        = s.value("connection/port").toString();
-    auto username    = s.value("connection/rpcuser").toString();
-    auto password    = s.value("connection/rpcpassword").toString();    
+    // Load from the saved settings
+    auto conf        = Settings::getInstance()->getSettings();
+    auto host        = conf.host;
+    auto port        = conf.port;
+    auto username    = conf.rpcuser;
+    auto password    = conf.rpcpassword;
 
     if (username.isEmpty() || password.isEmpty())
         return nullptr;
@@ -29,6 +29,7 @@ struct ConnectionConfig {
 };
 
 class Connection;
+class DaemonStartup;
 
 class ConnectionLoader {
 
@@ -50,21 +51,34 @@ private:
     void createCommerciumConf();
     QString locateCommerciumConfFile();
     QString commerciumConfWritableLocation();
+    QString commerciumDebugLogLocation();
     QString commerciumParamsDir();
 
     bool verifyParams();
     void downloadParams(std::function<void(void)> cb);
-    void doNextDownload(std::function<void(void)> cb);
+    void doDownloadParams(std::function<void(void)> cb);
     bool startEmbeddedCommerciumd();
 
     void refreshCommerciumdState(Connection* connection, std::function<void(void)> refused);
 
+    void scheduleProbe(std::function<void(void)> probe);
+    void probeNow();
+
     void showError(QString explanation);
     void showInformation(QString info, QString detail = "");
 
     void doRPCSetConnection(Connection* conn);
 
     QProcess*               ecommerciumd  = nullptr;
+    DaemonStartup*          startup       = nullptr;
+
+    // commerciumd is polled quickly at first, then less and less often while it starts
+    QTimer*                 probeTimer;
+    std::function<void(void)> pendingProbe;
+    int                     probeDelay    = minProbeDelay;
+
+    static const int        minProbeDelay = 100;
+    static const int        maxProbeDelay = 2000;
 
     QDialog*                d;
     Ui_ConnectionDialog*    connD;
@@ -72,12 +86,7 @@ private:
     MainWindow*             main;
     RPC*                    rpc;
 
-    QNetworkReply* currentDownload = nullptr;
-    QFile*         currentOutput   = nullptr;
-    QQueue<QUrl>*  downloadQueue   = nullptr;
-
-    QNetworkAccessManager* client  = nullptr; 
-    QTime downloadTime;
+    bool                    paramsVerified = false;
 };
 
 /**
@@ -0,0 +1,143 @@
+#include "daemonmonitor.h"
+#include "logger.h"
+#include "settings.h"
+
+#ifdef Q_OS_LINUX
+#include <unistd.h>
+#endif
+
+DaemonMonitor::DaemonMonitor(QObject* parent, QProcess* process, Logger* logger) :
+        QObject(parent), process(process), logger(logger) {
+    timer = new QTimer(this);
+    QObject::connect(timer, &QTimer::timeout, [=] () { sample(); });
+
+    if (isSupported())
+        timer->start(sampleInterval);
+}
+
+bool DaemonMonitor::isSupported() {
+#ifdef Q_OS_LINUX
+    return true;
+#else
+    return false;
+#endif
+}
+
+QVector<double> DaemonMonitor::series(std::function<double(const Sample&)> field) const {
+    QVector<double> values;
+    values.reserve(samples.size());
+    for (const auto& s : samples) {
+        values.push_back(field(s));
+    }
+    return values;
+}
+
+// Read the counters for the process. Returns false if it has gone away.
+bool DaemonMonitor::readCounters(qint64 pid, Counters& c) {
+#ifdef Q_OS_LINUX
+    QString dir = "/proc/" % QString::number(pid) % "/";
+
+    // The name in brackets can have spaces in it, so the fields are counted from after it. utime and
+    // stime are fields 14 and 15, num_threads is 20.
+    QFile stat(dir % "stat");
+    if (!stat.open(QIODevice::ReadOnly))
+        return false;
+    auto line   = stat.readAll();
+    auto fields = line.mid(line.lastIndexOf(')') + 2).split(' ');
+    if (fields.size() < 18)
+        return false;
+    c.cpuTicks = fields[11].toLongLong() + fields[12].toLongLong();
+    c.threads  = fields[17].toInt();
+
+    QFile statm(dir % "statm");
+    if (!statm.open(QIODevice::ReadOnly))
+        return false;
+    c.rssPages = statm.readAll().split(' ').value(1).toLongLong();
+
+    // Only readable by the same user, which the embedded commerciumd is
+    c.readBytes = c.writeBytes = 0;
+    QFile io(dir % "io");
+    if (io.open(QIODevice::ReadOnly)) {
+        for (const auto& l : io.readAll().split('\n')) {
+            if (l.startsWith("read_bytes:"))
+                c.readBytes = l.mid(11).trimmed().toLongLong();
+            else if (l.startsWith("write_bytes:"))
+                c.writeBytes = l.mid(12).trimmed().toLongLong();
+        }
+    }
+
+    c.fds  = QDir(dir % "fd").entryList(QDir::AllEntries | QDir::NoDotAndDotDot | QDir::System).size();
+    c.time = QDateTime::currentMSecsSinceEpoch();
+    return true;
+#else
+    Q_UNUSED(pid);
+    Q_UNUSED(c);
+    return false;
+#endif
+}
+
+void DaemonMonitor::sample() {
+#ifdef Q_OS_LINUX
+    qint64 pid = process->processId();
+    Counters c;
+    if (pid == 0 || !readCounters(pid, c))
+        return;
+
+    // The first reading, or a restarted commerciumd, only gives a starting point for the rates
+    if (pid != lastPid) {
+        lastPid = pid;
+        last    = c;
+        return;
+    }
+
+    static const double ticksPerSec = sysconf(_SC_CLK_TCK);
+    static const qint64 pageSize    = sysconf(_SC_PAGESIZE);
+
+    double secs = (c.time - last.time) / 1000.0;
+    if (secs <= 0)
+        return;
+
+    Sample s;
+    s.time        = c.time;
+    s.rssBytes    = c.rssPages * pageSize;
+    s.cpuPercent  = (c.cpuTicks - last.cpuTicks) / ticksPerSec / secs * 100;
+    s.readPerSec  = qMax<qint64>(0, c.readBytes - last.readBytes) / secs;
+    s.writePerSec = qMax<qint64>(0, c.writeBytes - last.writeBytes) / secs;
+    s.fds         = c.fds;
+    s.threads     = c.threads;
+    last = c;
+
+    samples.push_back(s);
+    if (samples.size() > maxSamples)
+        samples.removeFirst();
+
+    checkThresholds(s);
+
+    if (callback)
+        callback(s);
+#endif
+}
+
+// Thresholds of 0 are off
+void DaemonMonitor::checkThresholds(const Sample& s) {
+    auto opts = Settings::getInstance()->snapshot();
+
+    checkThreshold(opts->monitorRssMB > 0 && s.rssBytes > (qint64)opts->monitorRssMB * 1024 * 1024, rssOver,
+                   "memory use is " % QString::number(s.rssBytes / (1024 * 1024)) % " MB");
+    checkThreshold(opts->monitorCpuPercent > 0 && s.cpuPercent > opts->monitorCpuPercent, cpuOver,
+                   "CPU use is " % QString::number(s.cpuPercent, 'f', 0) % "%");
+    checkThreshold(opts->monitorIoMBps > 0 && (s.readPerSec + s.writePerSec) > opts->monitorIoMBps * 1024.0 * 1024, ioOver,
+                   "disk I/O is " % QString::number((s.readPerSec + s.writePerSec) / (1024 * 1024), 'f', 1) % " MB/s");
+    checkThreshold(opts->monitorFds > 0 && s.fds > opts->monitorFds, fdsOver,
+                   "open files are " % QString::number(s.fds));
+}
+
+// Only log when a threshold is crossed, not on every sample while it stays over
+void DaemonMonitor::checkThreshold(bool over, bool& wasOver, const QString& what) {
+    if (over && !wasOver)
+        LOG(logger, Warning, Daemon, "commerciumd " % what % ", over the threshold");
+    else if (!over && wasOver)
+        LOG(logger, Info, Daemon, "commerciumd " % what % ", back under the threshold");
+
+    wasOver = over;
+}
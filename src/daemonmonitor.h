@@ -0,0 +1,75 @@
+#ifndef DAEMONMONITOR_H
+#define DAEMONMONITOR_H
+
+#include "precompiled.h"
+
+class Logger;
+
+/**
+ * Samples what the embedded commerciumd is doing to the machine, from /proc/<pid>, every few seconds.
+ * The last few minutes are kept for the sparklines on the commerciumd tab. If thresholds are set in the
+ * options, crossing one is logged, so a slow sync can be matched up with memory, CPU or I/O pressure.
+ *
+ * /proc is Linux only. Elsewhere no samples are taken.
+ */
+class DaemonMonitor : public QObject
+{
+    Q_OBJECT
+public:
+    struct Sample {
+        qint64  time;           // ms since epoch
+        qint64  rssBytes;
+        double  cpuPercent;     // Of one core, so it can go over 100
+        double  readPerSec;     // Bytes read from storage
+        double  writePerSec;
+        int     fds;
+        int     threads;
+    };
+
+    DaemonMonitor(QObject* parent, QProcess* process, Logger* logger);
+
+    static bool             isSupported();
+
+    // Called on the GUI thread after every sample
+    void                    setCallback(std::function<void(const Sample&)> cb) { callback = cb; }
+
+    const QList<Sample>&    getSamples() const { return samples; }
+    QVector<double>         series(std::function<double(const Sample&)> field) const;
+
+private:
+    // Raw counters from /proc. The rates come from the difference between two of these.
+    struct Counters {
+        qint64  time;
+        qint64  cpuTicks;
+        qint64  rssPages;
+        qint64  readBytes;
+        qint64  writeBytes;
+        int     fds;
+        int     threads;
+    };
+
+    void    sample();
+    bool    readCounters(qint64 pid, Counters& c);
+    void    checkThresholds(const Sample& s);
+    void    checkThreshold(bool over, bool& wasOver, const QString& what);
+
+    QProcess*       process;
+    Logger*         logger;
+    QTimer*         timer;
+
+    QList<Sample>   samples;
+    Counters        last;
+    qint64          lastPid     = 0;
+
+    bool            rssOver     = false;
+    bool            cpuOver     = false;
+    bool            ioOver      = false;
+    bool            fdsOver     = false;
+
+    std::function<void(const Sample&)> callback;
+
+    static const int sampleInterval = 2000;     // ms
+    static const int maxSamples     = 180;      // 6 minutes
+};
+
+#endif // DAEMONMONITOR_H
@@ -0,0 +1,110 @@
+#include "daemonstartup.h"
+
+// What commerciumd logs as it starts, in order, and how far along that is. The text is matched
+// untranslated and shown translated.
+static const struct {
+    const char*             text;
+    DaemonStartup::Phase    phase;
+    int                     percent;
+} startupMarkers[] = {
+    { QT_TRANSLATE_NOOP("DaemonStartup", "Loading block index"),    DaemonStartup::LoadingBlockIndex,   5   },
+    { QT_TRANSLATE_NOOP("DaemonStartup", "Verifying blocks"),       DaemonStartup::VerifyingBlocks,     30  },
+    { QT_TRANSLATE_NOOP("DaemonStartup", "Verifying last"),         DaemonStartup::VerifyingBlocks,     30  },
+    { QT_TRANSLATE_NOOP("DaemonStartup", "Loading wallet"),         DaemonStartup::LoadingWallet,       60  },
+    { QT_TRANSLATE_NOOP("DaemonStartup", "Rescanning"),             DaemonStartup::Rescanning,          70  },
+    { QT_TRANSLATE_NOOP("DaemonStartup", "Activating best chain"),  DaemonStartup::ActivatingChain,     95  },
+    { QT_TRANSLATE_NOOP("DaemonStartup", "Loading addresses"),      DaemonStartup::ActivatingChain,     97  },
+    { QT_TRANSLATE_NOOP("DaemonStartup", "Done loading"),           DaemonStartup::Ready,               100 },
+};
+
+DaemonStartup::DaemonStartup(QObject* parent, const QString& debugLogName) : QObject(parent) {
+    // Only the lines written from now on are about this startup
+    log.setFileName(debugLogName);
+    if (log.open(QIODevice::ReadOnly))
+        log.seek(log.size());
+
+    logTimer = new QTimer(this);
+    QObject::connect(logTimer, &QTimer::timeout, [=] () { pollLog(); });
+    logTimer->start(pollInterval);
+}
+
+void DaemonStartup::stop() {
+    stopped = true;
+    callback = nullptr;
+    logTimer->stop();
+    log.close();
+}
+
+void DaemonStartup::pollLog() {
+    // debug.log might not exist until commerciumd creates it
+    if (!log.isOpen() && !log.open(QIODevice::ReadOnly))
+        return;
+
+    // It was truncated (shrinkdebugfile), so start again from the top
+    if (log.size() < log.pos())
+        log.seek(0);
+
+    addOutput(DebugLog, log.readAll());
+}
+
+void DaemonStartup::addOutput(Channel channel, const QByteArray& data) {
+    if (stopped)
+        return;
+
+    QByteArray& buffer = pending[channel];
+    buffer.append(data);
+
+    bool changed = false;
+    int start = 0, end;
+    while ((end = buffer.indexOf('\n', start)) >= 0) {
+        changed = parseLine(QString::fromUtf8(buffer.constData() + start, end - start), phase, percent, message) || changed;
+        start = end + 1;
+    }
+    buffer.remove(0, start);
+
+    if (changed && callback)
+        callback(phase, percent, message);
+
+    if (phase == Ready)
+        stop();
+}
+
+/**
+ * The markers move the phase forward. Within a phase, the block verification and rescan progress
+ * lines move the percentage between the start of that phase and the next.
+ */
+bool DaemonStartup::parseLine(const QString& line, Phase& phase, int& percent, QString& message) {
+    static QRegularExpression verifyProgress("\\[(\\d+)%\\]\\.\\.\\.");
+    static QRegularExpression rescanProgress("Still rescanning\\. At block (\\d+)\\. Progress=([0-9.]+)");
+
+    for (const auto& m : startupMarkers) {
+        if (m.phase >= phase && line.contains(QLatin1String(m.text))) {
+            if (m.phase == phase && m.percent <= percent)
+                return false;
+
+            phase   = m.phase;
+            percent = m.percent;
+            message = QCoreApplication::translate("DaemonStartup", m.text) % "...";
+            return true;
+        }
+    }
+
+    int next = percent;
+    if (phase == VerifyingBlocks) {
+        auto match = verifyProgress.match(line);
+        if (match.hasMatch())
+            next = 30 + match.captured(1).toInt() * 30 / 100;
+    } else if (phase == Rescanning) {
+        auto match = rescanProgress.match(line);
+        if (match.hasMatch()) {
+            next    = 70 + (int)(match.captured(2).toDouble() * 25);
+            message = QObject::tr("Rescanning... block ") % match.captured(1);
+        }
+    }
+
+    if (next <= percent)
+        return false;
+
+    percent = qMin(next, 99);
+    return true;
+}
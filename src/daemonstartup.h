@@ -0,0 +1,68 @@
+#ifndef DAEMONSTARTUP_H
+#define DAEMONSTARTUP_H
+
+#include "precompiled.h"
+
+/**
+ * Follows an embedded commerciumd while it starts up, so the connection dialog can show what it is
+ * doing and the RPC can be tried as soon as it's ready, instead of polling getinfo blindly.
+ *
+ * commerciumd only prints its init messages to the console with -printtoconsole, which would stop it
+ * writing debug.log. So besides its stdout and stderr, the new lines in debug.log are read too.
+ */
+class DaemonStartup : public QObject
+{
+    Q_OBJECT
+public:
+    enum Phase {
+        Starting = 0,
+        LoadingBlockIndex,
+        VerifyingBlocks,
+        LoadingWallet,
+        Rescanning,
+        ActivatingChain,
+        Ready
+    };
+
+    enum Channel {
+        Stdout = 0,
+        Stderr,
+        DebugLog
+    };
+
+    DaemonStartup(QObject* parent, const QString& debugLogName);
+
+    // Called whenever the phase or percentage changes
+    void    setCallback(std::function<void(Phase, int, QString)> cb) { callback = cb; }
+
+    // Output read from the process
+    void    addOutput(Channel channel, const QByteArray& data);
+
+    // Stop following debug.log. Output that still arrives is ignored.
+    void    stop();
+
+    Phase   getPhase()   { return phase; }
+    int     getPercent() { return percent; }
+    QString getMessage() { return message; }
+
+    // Update the phase, percentage and message from one line of output. Returns false if the line didn't say anything new.
+    static bool parseLine(const QString& line, Phase& phase, int& percent, QString& message);
+
+private:
+    void    pollLog();
+
+    QTimer*     logTimer;
+    QFile       log;
+    QByteArray  pending[3];     // Partial lines, for each channel
+    bool        stopped     = false;
+
+    Phase       phase       = Starting;
+    int         percent     = 0;
+    QString     message;
+
+    std::function<void(Phase, int, QString)> callback;
+
+    static const int pollInterval = 250;
+};
+
+#endif // DAEMONSTARTUP_H
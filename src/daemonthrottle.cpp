@@ -0,0 +1,136 @@
+#include "daemonthrottle.h"
+#include "logger.h"
+#include "settings.h"
+
+#ifdef Q_OS_LINUX
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// From linux/ioprio.h, which isn't always installed
+#define IOPRIO_CLASS_SHIFT              13
+#define IOPRIO_CLASS_BE                 2
+#define IOPRIO_CLASS_IDLE               3
+#define IOPRIO_WHO_PROCESS              1
+#define IOPRIO_PRIO_VALUE(cls, data)    (((cls) << IOPRIO_CLASS_SHIFT) | (data))
+#endif
+
+DaemonThrottle::DaemonThrottle(QObject* parent, QProcess* process, Logger* logger) :
+        QObject(parent), process(process), logger(logger) {
+#ifdef Q_OS_LINUX
+    // Going back from a nice of 10 to 0 needs RLIMIT_NICE to allow a nice of 0 (20 - rlim_cur)
+    struct rlimit limit;
+    canRestoreNice = geteuid() == 0 ||
+                     (getrlimit(RLIMIT_NICE, &limit) == 0 && (limit.rlim_cur == RLIM_INFINITY || limit.rlim_cur >= 20));
+    if (!canRestoreNice)
+        LOG(logger, Info, Daemon, "RLIMIT_NICE doesn't allow restoring commerciumd's CPU priority, only its I/O priority will be throttled");
+#else
+    canRestoreNice = false;
+#endif
+
+    sinceInteraction.start();
+    sinceUpdate.start();
+    qApp->installEventFilter(this);
+
+    timer = new QTimer(this);
+    QObject::connect(timer, &QTimer::timeout, [=] () { update(); });
+    QObject::connect(Settings::getInstance(), &Settings::optionsChanged, this, [=] () { update(); });
+
+    if (isSupported())
+        timer->start(updateInterval);
+}
+
+DaemonThrottle::~DaemonThrottle() {
+    qApp->removeEventFilter(this);
+}
+
+bool DaemonThrottle::isSupported() {
+#ifdef Q_OS_LINUX
+    return true;
+#else
+    return false;
+#endif
+}
+
+double DaemonThrottle::blocksPerSec(Mode m) {
+    return msecs[m] > 0 ? blocks[m] * 1000.0 / msecs[m] : 0;
+}
+
+bool DaemonThrottle::eventFilter(QObject* obj, QEvent* event) {
+    switch (event->type()) {
+    case QEvent::KeyPress:
+    case QEvent::MouseButtonPress:
+    case QEvent::MouseMove:
+    case QEvent::Wheel:
+        sinceInteraction.restart();
+        break;
+    default:
+        break;
+    }
+
+    return QObject::eventFilter(obj, event);
+}
+
+// Credit the blocks synced since the last update to the current mode, then pick the mode
+void DaemonThrottle::update() {
+    if (!isSupported() || process->processId() == 0)
+        return;
+
+    bool syncing = Settings::getInstance()->isSyncing();
+    int  block   = Settings::getInstance()->getBlockNumber();
+    auto elapsed = sinceUpdate.restart();
+
+    bool changed = false;
+    if (syncing && lastBlock >= 0 && block >= lastBlock) {
+        blocks[mode] += block - lastBlock;
+        msecs[mode]  += elapsed;
+        changed = true;
+    }
+    lastBlock = block;
+
+    Mode want;
+    switch (Settings::getInstance()->getThrottlePolicy()) {
+    case AlwaysFullSpeed:   want = FullSpeed;  break;
+    case AlwaysBackground:  want = Background; break;
+    default:
+        want = syncing && sinceInteraction.elapsed() < idleAfter ? Background : FullSpeed;
+        break;
+    }
+
+    // A restarted commerciumd starts with normal priorities
+    if (want != mode || process->processId() != appliedPid) {
+        apply(want);
+        changed = true;
+    }
+
+    if (changed && callback)
+        callback();
+}
+
+void DaemonThrottle::apply(Mode m) {
+#ifdef Q_OS_LINUX
+    qint64 pid   = process->processId();
+    int    nice  = m == Background ? backgroundNice : 0;
+    int    ioprio = m == Background ? IOPRIO_PRIO_VALUE(IOPRIO_CLASS_IDLE, 0) : IOPRIO_PRIO_VALUE(IOPRIO_CLASS_BE, 4);
+
+    int failed = 0;
+    auto threads = QDir("/proc/" % QString::number(pid) % "/task").entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+    for (const auto& t : threads) {
+        int tid = t.toInt();
+        if (canRestoreNice && setpriority(PRIO_PROCESS, tid, nice) != 0)
+            failed++;
+        if (syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, tid, ioprio) != 0)
+            failed++;
+    }
+
+    mode       = m;
+    appliedPid = pid;
+
+    QString msg = QString("commerciumd is now in ") % (m == Background ? "background" : "full speed") % " mode";
+    if (failed > 0)
+        msg = msg % ", " % QString::number(failed) % " priority changes failed";
+    LOG(logger, Info, Daemon, msg);
+#else
+    Q_UNUSED(m);
+#endif
+}
@@ -0,0 +1,76 @@
+#ifndef DAEMONTHROTTLE_H
+#define DAEMONTHROTTLE_H
+
+#include "precompiled.h"
+
+class Logger;
+
+/**
+ * Backs the embedded commerciumd off while the user is working, so the initial sync doesn't make the
+ * machine sluggish. In background mode commerciumd gets the idle I/O class and a higher nice value,
+ * in full speed mode its normal priorities back. In Auto, it is in background mode while the wallet
+ * is being used during a sync, and at full speed once the wallet has been left alone for a while.
+ *
+ * Linux nice and I/O priorities are per thread, so every thread in /proc/<pid>/task is changed. An
+ * unprivileged process can't lower a nice value again unless RLIMIT_NICE allows it, so if it doesn't,
+ * only the I/O priority is changed. Other platforms aren't supported.
+ */
+class DaemonThrottle : public QObject
+{
+    Q_OBJECT
+public:
+    enum Policy {
+        Auto = 0,
+        AlwaysFullSpeed,
+        AlwaysBackground
+    };
+
+    enum Mode {
+        FullSpeed = 0,
+        Background
+    };
+
+    DaemonThrottle(QObject* parent, QProcess* process, Logger* logger);
+    ~DaemonThrottle();
+
+    static bool isSupported();
+
+    Mode        getMode() { return mode; }
+
+    // Measured sync speed in each mode. 0 until there's been a sync in that mode.
+    double      blocksPerSec(Mode m);
+
+    // Called on the GUI thread when the mode or the measured speeds change
+    void        setCallback(std::function<void(void)> cb) { callback = cb; }
+
+    // Notices the user using the wallet
+    bool        eventFilter(QObject* obj, QEvent* event) override;
+
+private:
+    void        update();
+    void        apply(Mode m);
+
+    QProcess*       process;
+    Logger*         logger;
+    QTimer*         timer;
+
+    Mode            mode            = FullSpeed;
+    qint64          appliedPid      = 0;
+    bool            canRestoreNice;
+
+    QElapsedTimer   sinceInteraction;
+
+    // Blocks synced and time spent syncing in each mode
+    qint64          blocks[2]       = { 0, 0 };
+    qint64          msecs[2]        = { 0, 0 };
+    int             lastBlock       = -1;
+    QElapsedTimer   sinceUpdate;
+
+    std::function<void(void)> callback;
+
+    static const int updateInterval = 5000;     // ms
+    static const int idleAfter      = 60000;    // ms without input before going back to full speed
+    static const int backgroundNice = 10;
+};
+
+#endif // DAEMONTHROTTLE_H
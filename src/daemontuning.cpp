@@ -0,0 +1,109 @@
+#include "daemontuning.h"
+#include "settings.h"
+
+#if defined(Q_OS_DARWIN)
+#include <sys/sysctl.h>
+#elif defined(Q_OS_WIN)
+#include <windows.h>
+#endif
+
+QList<QPair<QString, QString>> DaemonTuning::Tuning::options() const {
+    return {
+        { "dbcache",        QString::number(dbcache) },
+        { "par",            QString::number(par) },
+        { "rpcthreads",     QString::number(rpcthreads) },
+        { "rpcworkqueue",   QString::number(rpcworkqueue) },
+        { "maxconnections", QString::number(maxconnections) }
+    };
+}
+
+qint64 DaemonTuning::totalRam() {
+#if defined(Q_OS_LINUX)
+    QFile meminfo("/proc/meminfo");
+    if (!meminfo.open(QIODevice::ReadOnly))
+        return 0;
+
+    // MemTotal:       16314628 kB
+    while (!meminfo.atEnd()) {
+        auto fields = QString::fromLatin1(meminfo.readLine()).simplified().split(' ');
+        if (fields.size() >= 2 && fields[0] == "MemTotal:")
+            return fields[1].toLongLong() * 1024;
+    }
+    return 0;
+#elif defined(Q_OS_DARWIN)
+    quint64 memsize = 0;
+    size_t  length  = sizeof(memsize);
+    if (sysctlbyname("hw.memsize", &memsize, &length, nullptr, 0) != 0)
+        return 0;
+    return (qint64)memsize;
+#elif defined(Q_OS_WIN)
+    MEMORYSTATUSEX status;
+    status.dwLength = sizeof(status);
+    if (!GlobalMemoryStatusEx(&status))
+        return 0;
+    return (qint64)status.ullTotalPhys;
+#else
+    return 0;
+#endif
+}
+
+DaemonTuning::Hardware DaemonTuning::detect(const QString& dataDir) {
+    QStorageInfo storage(dataDir);
+
+    return Hardware{ qMax(1, QThread::idealThreadCount()),
+                     totalRam(),
+                     storage.isValid() ? storage.bytesAvailable() : -1 };
+}
+
+/**
+ * A quarter of the memory goes to the UTXO cache, which is what speeds up the initial sync the most.
+ * One core is left for the wallet itself. Small machines get fewer peers, since each one costs memory
+ * and bandwidth.
+ */
+DaemonTuning::Tuning DaemonTuning::propose(const Hardware& hw) {
+    qint64 ramMB = hw.ramBytes / (1024 * 1024);
+
+    Tuning t;
+    t.dbcache       = ramMB > 0 ? (int)qBound<qint64>(100, ramMB / 4, 4096) : 450;
+    t.par           = qBound(1, hw.cores - 1, 16);
+    t.rpcthreads    = qBound(4, hw.cores / 2, 8);
+    t.rpcworkqueue  = t.rpcthreads * 8;
+
+    if (ramMB > 0 && ramMB < 2048)
+        t.maxconnections = 16;
+    else if ((ramMB > 0 && ramMB < 4096) || hw.cores <= 2)
+        t.maxconnections = 32;
+    else
+        t.maxconnections = 125;
+
+    return t;
+}
+
+QString DaemonTuning::describe(const Hardware& hw, const Tuning& tuning) {
+    QString text = QObject::tr("This computer has ") % QString::number(hw.cores) % QObject::tr(" cores");
+    if (hw.ramBytes > 0)
+        text = text % QObject::tr(" and ") % QString::number(hw.ramBytes / (1024 * 1024 * 1024.0), 'f', 1) % QObject::tr(" GB of memory");
+    text = text % ".\n\n" % QObject::tr("Suggested commercium.conf options:") % "\n";
+
+    for (const auto& option : tuning.options()) {
+        text = text % option.first % "=" % option.second % "\n";
+    }
+
+    if (hw.freeDiskBytes >= 0 && hw.freeDiskBytes < lowDiskBytes) {
+        text = text % "\n" % QObject::tr("Only ") % QString::number(hw.freeDiskBytes / (1024 * 1024 * 1024.0), 'f', 1) %
+               QObject::tr(" GB of disk space is free in the data directory, which may not be enough for the blockchain.") % "\n";
+    }
+
+    return text;
+}
+
+bool DaemonTuning::apply(const QString& confLocation, const Tuning& tuning) {
+    for (const auto& option : tuning.options()) {
+        if (!Settings::removeFromCommerciumConf(confLocation, option.first))
+            return false;
+        if (!Settings::addToCommerciumConf(confLocation, option.first % "=" % option.second))
+            return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,44 @@
+#ifndef DAEMONTUNING_H
+#define DAEMONTUNING_H
+
+#include "precompiled.h"
+
+/**
+ * Suggests commercium.conf options for the embedded commerciumd that suit this computer. The defaults
+ * are meant for a small machine, so a big one syncs slower than it could, and a small VM can still be
+ * swamped by connections.
+ */
+class DaemonTuning {
+public:
+    struct Hardware {
+        int     cores;
+        qint64  ramBytes;           // 0 if it couldn't be found out
+        qint64  freeDiskBytes;      // In the data directory, or -1
+    };
+
+    struct Tuning {
+        int     dbcache;            // MB
+        int     par;                // Script verification threads
+        int     rpcthreads;
+        int     rpcworkqueue;
+        int     maxconnections;
+
+        QList<QPair<QString, QString>> options() const;
+    };
+
+    static Hardware detect(const QString& dataDir);
+    static Tuning   propose(const Hardware& hw);
+
+    // Readable summary of the hardware and the proposed options, to show before applying them
+    static QString  describe(const Hardware& hw, const Tuning& tuning);
+
+    // Replace the options in commercium.conf. commerciumd has to be restarted to use them.
+    static bool     apply(const QString& confLocation, const Tuning& tuning);
+
+private:
+    static qint64   totalRam();
+
+    static const qint64 lowDiskBytes = 10LL * 1024 * 1024 * 1024;
+};
+
+#endif // DAEMONTUNING_H
@@ -0,0 +1,114 @@
+#include "ioexecutor.h"
+
+IOExecutor* IOExecutor::instance = nullptr;
+
+namespace {
+    // Carries a done callback over to the GUI thread. This works on Qt versions that can't
+    // invoke a functor in another thread directly.
+    class DoneEvent : public QEvent {
+    public:
+        DoneEvent(std::function<void()> done) : QEvent(QEvent::User), done(done) {}
+
+        std::function<void()> done;
+    };
+
+    class DoneReceiver : public QObject {
+    public:
+        bool event(QEvent* e) override {
+            if (e->type() != QEvent::User)
+                return QObject::event(e);
+
+            static_cast<DoneEvent*>(e)->done();
+            return true;
+        }
+    };
+}
+
+IOExecutor* IOExecutor::getInstance() {
+    if (instance == nullptr)
+        instance = new IOExecutor();
+
+    return instance;
+}
+
+IOExecutor::IOExecutor() {
+    // Created on the GUI thread, so the done callbacks are run there
+    receiver = new DoneReceiver();
+    thread = std::thread([=] () { run(); });
+}
+
+void IOExecutor::submit(std::function<void()> task, std::function<void()> done) {
+    std::unique_lock<std::mutex> guard(lock);
+
+    // After shutdown, just run the task right here
+    if (stopping) {
+        guard.unlock();
+        task();
+        return;
+    }
+
+    if (done) {
+        tasks.push_back([=] () {
+            task();
+            QCoreApplication::postEvent(receiver, new DoneEvent(done));
+        });
+    } else {
+        tasks.push_back(task);
+    }
+
+    taskAvailable.notify_one();
+}
+
+void IOExecutor::runAside(std::function<void()> task, std::function<void()> done) {
+    auto receiver = this->receiver;
+    std::thread([=] () {
+        task();
+        if (done)
+            QCoreApplication::postEvent(receiver, new DoneEvent(done));
+    }).detach();
+}
+
+void IOExecutor::waitForIdle() {
+    std::unique_lock<std::mutex> guard(lock);
+    idle.wait(guard, [=] () { return tasks.empty() && !busy; });
+}
+
+void IOExecutor::shutdown() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (stopping)
+            return;
+
+        stopping = true;
+        taskAvailable.notify_one();
+    }
+
+    thread.join();
+}
+
+void IOExecutor::run() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            taskAvailable.wait(guard, [=] () { return !tasks.empty() || stopping; });
+
+            // Finish everything that was queued before stopping
+            if (tasks.empty())
+                return;
+
+            task = tasks.front();
+            tasks.pop_front();
+            busy = true;
+        }
+
+        task();
+
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            busy = false;
+            if (tasks.empty())
+                idle.notify_all();
+        }
+    }
+}
@@ -0,0 +1,45 @@
+#ifndef IOEXECUTOR_H
+#define IOEXECUTOR_H
+
+#include "precompiled.h"
+
+/**
+ * A single background thread that does the wallet's disk writes, so a slow disk or a networked
+ * home directory doesn't stall the UI. Tasks run one at a time, in the order they were submitted,
+ * so writes to the same file never overtake each other.
+ */
+class IOExecutor {
+public:
+    static IOExecutor* getInstance();
+
+    // Run the task on the I/O thread. If done is set, it is called on the GUI thread after the task has run.
+    void submit(std::function<void()> task, std::function<void()> done = nullptr);
+
+    // Run a long task, like hashing the params, on a thread of its own instead, so it doesn't hold
+    // up the queue. done is called on the GUI thread the same way.
+    void runAside(std::function<void()> task, std::function<void()> done = nullptr);
+
+    // Block until all the tasks submitted so far have run
+    void waitForIdle();
+
+    // Run the remaining tasks and stop the thread. Called when the app exits.
+    void shutdown();
+
+private:
+    IOExecutor();
+
+    void run();
+
+    QObject*                            receiver;   // Lives on the GUI thread
+    std::thread                         thread;
+    std::mutex                          lock;
+    std::condition_variable             taskAvailable;
+    std::condition_variable             idle;
+    std::deque<std::function<void()>>   tasks;
+    bool                                busy        = false;
+    bool                                stopping    = false;
+
+    static IOExecutor*                  instance;
+};
+
+#endif // IOEXECUTOR_H
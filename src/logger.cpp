@@ -1,29 +1,152 @@
 #include "logger.h"
 
-Logger::Logger(QObject *parent, QString fileName) : QObject(parent) {
+Logger::Logger(QObject *parent, QString fileName) : QObject(parent),
+        minLevel(Info), enabledCategories(AllCategories), tail(0), head(0), dropped(0), stopping(false) {
     m_showDate = true;
     if (!fileName.isEmpty()) {
         file = new QFile;
         file->setFileName(fileName);
         file->open(QIODevice::Append | QIODevice::Text);
+
+        ring = new Record[ringSize];
+        for (int i = 0; i < ringSize; i++) {
+            ring[i].seq.store(i, std::memory_order_relaxed);
+        }
+
+        writer = std::thread([=] () { run(); });
     }
     write("=========Startup==========");
 }
 
 void Logger::write(const QString &value) {
-    if (!file)
+    write(Info, General, value);
+}
+
+void Logger::write(Level level, Category category, const QString &value) {
+    if (!isEnabled(level, category))
+        return;
+
+    if (!push(level, category, value)) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
         return;
-        
-    QString text = value;// + "";
-    text = QDateTime::currentDateTime().toString("dd.MM.yyyy hh:mm:ss ") + text;
-    QTextStream out(file);
-    out.setCodec("UTF-8");
-    if (file != 0) {
-        out << text << endl;
     }
+
+    // Wake the writer early if a lot of lines are waiting. It also wakes up by itself on a timer.
+    if (tail.load(std::memory_order_relaxed) - head.load(std::memory_order_relaxed) == flushThreshold)
+        wake.notify_one();
 }
 
 Logger::~Logger() {
-    if (file != 0)
+    if (file != 0) {
+        // The writer writes out everything that is still in the ring before it stops
+        stopping = true;
+        wake.notify_one();
+        writer.join();
+
         file->close();
-}
\ No newline at end of file
+        delete file;
+        delete[] ring;
+    }
+}
+
+// Claim the next slot in the ring and fill it in. Returns false if the ring is full.
+bool Logger::push(Level level, Category category, const QString &value) {
+    quint64 pos = tail.load(std::memory_order_relaxed);
+    Record* record;
+    while (true) {
+        record = &ring[pos & (ringSize - 1)];
+        qint64 diff = (qint64)(record->seq.load(std::memory_order_acquire) - pos);
+        if (diff == 0) {
+            if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        } else if (diff < 0) {
+            return false;
+        } else {
+            pos = tail.load(std::memory_order_relaxed);
+        }
+    }
+
+    record->time     = QDateTime::currentMSecsSinceEpoch();
+    record->level    = level;
+    record->category = category;
+    record->text     = value;
+    record->seq.store(pos + 1, std::memory_order_release);
+
+    return true;
+}
+
+// Take the oldest line out of the ring and format it. Only called from the writer thread.
+bool Logger::pop(QByteArray& out) {
+    static const char* levels[] = { "DEBUG", "INFO ", "WARN ", "ERROR" };
+
+    quint64 pos = head.load(std::memory_order_relaxed);
+    Record* record = &ring[pos & (ringSize - 1)];
+    if (record->seq.load(std::memory_order_acquire) != pos + 1)
+        return false;
+
+    QString category;
+    switch (record->category) {
+    case Connection:    category = "[connection] "; break;
+    case Params:        category = "[params] ";     break;
+    case Daemon:        category = "[daemon] ";     break;
+    default:            break;
+    }
+
+    out += (QDateTime::fromMSecsSinceEpoch(record->time).toString("dd.MM.yyyy hh:mm:ss ") %
+            QLatin1String(levels[record->level]) % " " % category % record->text % "\n").toUtf8();
+
+    record->text = QString();
+    record->seq.store(pos + ringSize, std::memory_order_release);
+    head.store(pos + 1, std::memory_order_relaxed);
+
+    return true;
+}
+
+void Logger::run() {
+    QByteArray batch;
+    while (true) {
+        bool stop;
+        {
+            std::unique_lock<std::mutex> guard(wakeLock);
+            wake.wait_for(guard, std::chrono::milliseconds(flushInterval), [=] () {
+                return stopping || tail.load() - head.load() >= (quint64)flushThreshold;
+            });
+            stop = stopping;
+        }
+
+        while (pop(batch))
+            ;
+
+        auto lost = dropped.exchange(0);
+        if (lost > 0) {
+            batch += (QDateTime::currentDateTime().toString("dd.MM.yyyy hh:mm:ss ") %
+                      "WARN  " % QString::number(lost) % " log lines were dropped\n").toUtf8();
+        }
+
+        if (!batch.isEmpty()) {
+            file->write(batch);
+            file->flush();
+            batch.clear();
+
+            if (file->size() > maxFileSize)
+                rotate();
+        }
+
+        if (stop)
+            return;
+    }
+}
+
+// cmm-qt-wallet.log becomes cmm-qt-wallet.log.1, .1 becomes .2, and so on
+void Logger::rotate() {
+    auto name = file->fileName();
+    file->close();
+
+    QFile::remove(name % "." % QString::number(keepFiles));
+    for (int i = keepFiles - 1; i > 0; i--) {
+        QFile::rename(name % "." % QString::number(i), name % "." % QString::number(i + 1));
+    }
+    QFile::rename(name, name % ".1");
+
+    file->open(QIODevice::Append | QIODevice::Text);
+}
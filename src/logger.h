@@ -3,20 +3,90 @@
 
 #include "precompiled.h"
 
+// Only builds the message if the level and category are enabled, so disabled logging costs nothing
+#define LOG(logger, level, category, msg)                               \
+    do {                                                                \
+        if ((logger)->isEnabled(Logger::level, Logger::category))       \
+            (logger)->write(Logger::level, Logger::category, (msg));    \
+    } while (0)
+
+/**
+ * Writes the wallet's log file. Callers only put the line into a lock-free ring buffer. A writer
+ * thread formats the lines and writes them out in batches, either every flushInterval ms or as soon
+ * as flushThreshold lines are waiting. The file is rotated once it gets bigger than maxFileSize.
+ */
 class Logger : public QObject
 {
   Q_OBJECT
 public:
+  enum Level {
+      Debug = 0,
+      Info,
+      Warning,
+      Error
+  };
+
+  enum Category {
+      General       = 0x1,
+      Connection    = 0x2,
+      Params        = 0x4,
+      Daemon        = 0x8,
+      AllCategories = 0xF
+  };
+
   explicit Logger(QObject *parent, QString fileName);
   ~Logger();
 
+  bool isEnabled(Level level, Category category) const {
+      return file != nullptr && level >= minLevel.load(std::memory_order_relaxed) &&
+             (enabledCategories.load(std::memory_order_relaxed) & category) != 0;
+  }
+
+  void setLevel(Level level)        { minLevel = level; }
+  void setCategories(int categories) { enabledCategories = categories; }
+
+  void write(Level level, Category category, const QString &value);
+
 private:
+  struct Record {
+      std::atomic<quint64> seq;     // Which lap of the ring this slot is ready for
+      qint64               time;
+      Level                level;
+      Category             category;
+      QString              text;
+  };
+
+  bool push(Level level, Category category, const QString &value);
+  bool pop(QByteArray& out);
+  void run();
+  void rotate();
+
   QFile *file      = nullptr;
   bool m_showDate;
 
+  std::atomic<int>      minLevel;
+  std::atomic<int>      enabledCategories;
+
+  Record*               ring        = nullptr;
+  std::atomic<quint64>  tail;                   // Next slot to be written by a caller
+  std::atomic<quint64>  head;                   // Next slot to be read by the writer thread
+  std::atomic<quint64>  dropped;                // Lines lost because the ring was full
+
+  std::thread               writer;
+  std::mutex                wakeLock;
+  std::condition_variable   wake;
+  std::atomic<bool>         stopping;
+
+  static const int      ringSize        = 4096;     // Must be a power of 2
+  static const int      flushThreshold  = 256;
+  static const int      flushInterval   = 250;
+  static const qint64   maxFileSize     = 5 * 1024 * 1024;
+  static const int      keepFiles       = 3;        // Rotated files kept besides the current one
+
 signals:
 
 public slots:
+  // Logs at Info level, in the General category
   void write(const QString &value);
 };
 
@@ -1,11 +1,19 @@
 #include "mainwindow.h"
 #include "settings.h"
 #include "turnstile.h"
+#include "walletstore.h"
+#include "paymentqrbatch.h"
 
 #include "version.h"
 
 int main(int argc, char *argv[])
 {
+    // Generating payment QR codes in bulk doesn't need a display, so it runs before any GUI is set up
+    if (argc >= 2 && QString::fromLocal8Bit(argv[1]) == "--qr-batch") {
+        QCoreApplication a(argc, argv);
+        return PaymentQrBatch::runCommandLine(QCoreApplication::arguments());
+    }
+
     QCoreApplication::setAttribute(Qt::AA_UseHighDpiPixmaps);
     QCoreApplication::setAttribute(Qt::AA_EnableHighDpiScaling);
 
@@ -41,6 +49,9 @@ int main(int argc, char *argv[])
 
     Settings::init();
 
+    // Read the wallet store while the UI is being set up
+    WalletStore::preload();
+
     if (argc >= 2 && QString::fromStdString(argv[1]) == "--no-embedded") {
         Settings::getInstance()->setUseEmbedded(false);
     } else {
@@ -14,6 +14,11 @@
 #include "version.h"
 #include "turnstile.h"
 #include "senttxstore.h"
+#include "walletstore.h"
+#include "ioexecutor.h"
+#include "paramsverifier.h"
+#include "daemontuning.h"
+#include "syncmonitor.h"
 #include "connection.h"
 
 using json = nlohmann::json;
@@ -24,6 +29,17 @@ MainWindow::MainWindow(QWidget *parent) :
 {
     ui->setupUi(this);
     logger = new Logger(this, QDir(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)).filePath("cmm-qt-wallet.log"));
+    if (qEnvironmentVariableIsSet("CMM_DEBUG_LOG"))
+        logger->setLevel(Logger::Debug);
+
+    // The store keeps unwritten changes in memory and keeps trying, but the user should know
+    // that labels and sent transactions aren't being saved
+    WalletStore::getInstance()->setLogger(logger);
+    WalletStore::getInstance()->setFailureCallback([=] (QString what) {
+        QMessageBox::warning(this, tr("Couldn't save wallet data"),
+            what % "\n\n" % tr("Address labels and sent transactions will be saved once the file can be written to again. "
+                              "Check that the disk isn't full."), QMessageBox::Ok);
+    });
 
     // Status Bar
     setupStatusBar();
@@ -42,6 +58,9 @@ MainWindow::MainWindow(QWidget *parent) :
         QDesktopServices::openUrl(QUrl("https://github.com/CommerciumBlockchain/cmm-qt-wallet/releases"));
     });
 
+    // Verify params
+    QObject::connect(ui->actionVerify_params, &QAction::triggered, this, &MainWindow::verifyParams);
+
     // Import Private Key
     QObject::connect(ui->actionImport_Private_Key, &QAction::triggered, this, &MainWindow::importPrivKey);
 
@@ -54,6 +73,9 @@ MainWindow::MainWindow(QWidget *parent) :
     // Export transactions
     QObject::connect(ui->actionExport_transactions, &QAction::triggered, this, &MainWindow::exportTransactions);
 
+    // Export sync measurements, from the commerciumd tab
+    QObject::connect(ui->btnExportSync, &QPushButton::clicked, this, &MainWindow::exportSyncMetrics);
+
     // z-Board.net
     QObject::connect(ui->actionz_board_net, &QAction::triggered, this, &MainWindow::postToZBoard);
 
@@ -407,6 +429,34 @@ void MainWindow::setupSettingsModal() {
             settings.lblTor->setToolTip(tooltip);
         }
 
+        // Tune commerciumd
+        auto commerciumdConf = Settings::getInstance()->getCommerciumdConfLocation();
+        if (rpc->getECommerciumD() == nullptr || commerciumdConf.isEmpty()) {
+            settings.btnTune->setEnabled(false);
+            settings.lblTune->setEnabled(false);
+            QString tooltip = tr("Tuning is available only when running an embedded commerciumd.");
+            settings.btnTune->setToolTip(tooltip);
+            settings.lblTune->setToolTip(tooltip);
+        }
+        QObject::connect(settings.btnTune, &QPushButton::clicked, [=]() {
+            auto hw     = DaemonTuning::detect(QFileInfo(commerciumdConf).absolutePath());
+            auto tuning = DaemonTuning::propose(hw);
+
+            if (QMessageBox::question(this, tr("Tune commerciumd"), 
+                    DaemonTuning::describe(hw, tuning) % "\n" % tr("Write these to commercium.conf?"),
+                    QMessageBox::Yes, QMessageBox::Cancel) != QMessageBox::Yes)
+                return;
+
+            if (DaemonTuning::apply(commerciumdConf, tuning)) {
+                QMessageBox::information(this, tr("Tune commerciumd"), 
+                    tr("commercium.conf has been updated. To use the new options, you need to restart cmm-qt-wallet."), 
+                    QMessageBox::Ok);
+            } else {
+                QMessageBox::critical(this, tr("Tune commerciumd"), 
+                    tr("Couldn't update ") % commerciumdConf, QMessageBox::Ok);
+            }
+        });
+
         // Connection Settings
         QIntValidator validator(0, 65535);
         settings.port->setValidator(&validator);
@@ -439,12 +489,8 @@ void MainWindow::setupSettingsModal() {
         settings.tabWidget->setCurrentIndex(0);
 
         if (settingsDialog.exec() == QDialog::Accepted) {
-            // Custom fees
-            bool customFees = settings.chkCustomFees->isChecked();
-            Settings::getInstance()->setAllowCustomFees(customFees);
-            ui->minerFeeAmt->setReadOnly(!customFees);
-            if (!customFees)
-                ui->minerFeeAmt->setText(Settings::getDecimalString(Settings::getMinerFee()));
+            // Custom fees. The send tab picks up the change from Settings::optionsChanged
+            Settings::getInstance()->setAllowCustomFees(settings.chkCustomFees->isChecked());
 
             // Auto shield
             Settings::getInstance()->setAutoShield(settings.chkAutoShield->isChecked());
@@ -698,12 +744,78 @@ void MainWindow::exportTransactions() {
     if (csvName.isEmpty())
         return;
 
-    if (!rpc->getTransactionsModel()->exportToCsv(csvName.toLocalFile())) {
-        QMessageBox::critical(this, tr("Error"), 
-            tr("Error exporting transactions, file was not saved"), QMessageBox::Ok);
-    }
+    rpc->getTransactionsModel()->exportToCsv(csvName.toLocalFile(), [=] (bool ok) {
+        if (!ok) {
+            QMessageBox::critical(this, tr("Error"), 
+                tr("Error exporting transactions, file was not saved"), QMessageBox::Ok);
+        }
+    });
 } 
 
+/**
+ * Export the sync measurements as JSON, with the machine they were taken on, so syncs on different
+ * machines or with different commercium.conf options can be compared.
+ */
+void MainWindow::exportSyncMetrics() {
+    QString exportName = "commercium-sync-" + QDateTime::currentDateTime().toString("yyyyMMdd-hhmm") + ".json";
+
+    QUrl jsonName = QFileDialog::getSaveFileUrl(this,
+            tr("Export sync measurements"), exportName, "JSON file (*.json)");
+
+    if (jsonName.isEmpty())
+        return;
+
+    auto fileName = jsonName.toLocalFile();
+    auto contents = QJsonDocument(rpc->getSyncMonitor()->toJson()).toJson();
+    auto ok       = std::make_shared<bool>(false);
+    IOExecutor::getInstance()->submit([=] () {
+        QFile file(fileName);
+        *ok = file.open(QIODevice::WriteOnly | QIODevice::Truncate) && file.write(contents) == contents.size();
+    }, [=] () {
+        if (!*ok) {
+            QMessageBox::critical(this, tr("Error"),
+                tr("Error exporting sync measurements, file was not saved"), QMessageBox::Ok);
+        }
+    });
+}
+
+/**
+ * Hash all the params again, ignoring what was verified before. The files are hashed in parallel, away
+ * from the GUI thread. Corrupt files aren't deleted here, since commerciumd may be using them; they are
+ * downloaded again the next time the wallet starts.
+ */
+void MainWindow::verifyParams() {
+    QString paramsDir = ParamsVerifier::paramsLocation();
+
+    QStringList present, missing;
+    for (const auto& name : ParamsVerifier::fileNames()) {
+        if (QFile::exists(QDir(paramsDir).filePath(name)))
+            present.push_back(name);
+        else
+            missing.push_back(name);
+    }
+
+    ui->actionVerify_params->setEnabled(false);
+    ui->statusBar->showMessage(tr("Verifying params..."));
+
+    auto bad = std::make_shared<QStringList>();
+    IOExecutor::getInstance()->runAside([=] () {
+        *bad = ParamsVerifier::verify(paramsDir, present);
+    }, [=] () {
+        ui->actionVerify_params->setEnabled(true);
+        ui->statusBar->clearMessage();
+
+        auto problems = *bad + missing;
+        if (problems.isEmpty()) {
+            QMessageBox::information(this, tr("Verify params"), tr("All the params are OK"), QMessageBox::Ok);
+        } else {
+            QMessageBox::warning(this, tr("Verify params"),
+                tr("These params are missing or corrupt, and will be downloaded again when the wallet restarts:\n") %
+                problems.join("\n"), QMessageBox::Ok);
+        }
+    });
+}
+
 /**
  * Backup the wallet.dat file. This is kind of a hack, since it has to read from the filesystem rather than an RPC call
  * This might fail for various reasons - Remote commerciumd, non-standard locations, custom params passed to commerciumd, many others
@@ -917,6 +1029,55 @@ void MainWindow::setupCommerciumdTab() {
 }
 
 void MainWindow::setupTransactionsTab() {
+    // Search and filter bar. The filter is applied on every change, the model keeps an index
+    // so this is cheap even on very large histories.
+    ui->txTypeFilter->addItem(tr("All types"), "");
+    ui->txTypeFilter->addItem(tr("Sent"),      "send");
+    ui->txTypeFilter->addItem(tr("Received"),  "receive");
+    ui->txTypeFilter->addItem(tr("Mined"),     "generate");
+
+    // The minimum date is used to mean "no date filter"
+    for (auto dateEdit : { ui->txFromDate, ui->txToDate }) {
+        dateEdit->setMinimumDate(QDate(2009, 1, 1));
+        dateEdit->setSpecialValueText(tr("Any"));
+        dateEdit->setDate(dateEdit->minimumDate());
+    }
+
+    for (auto amtEdit : { ui->txMinAmount, ui->txMaxAmount }) {
+        auto amtValidator = new QDoubleValidator(0, 21000000, 8, amtEdit);
+        amtValidator->setNotation(QDoubleValidator::StandardNotation);
+        amtEdit->setValidator(amtValidator);
+    }
+
+    auto fnApplyTxFilter = [=] () {
+        auto txModel = dynamic_cast<TxTableModel *>(ui->transactionsTable->model());
+        if (txModel == nullptr)
+            return;
+
+        TxFilter filter;
+        filter.text = ui->txSearch->text();
+        filter.type = ui->txTypeFilter->currentData().toString();
+
+        if (ui->txFromDate->date() != ui->txFromDate->minimumDate())
+            filter.fromTime = QDateTime(ui->txFromDate->date()).toMSecsSinceEpoch() / (qint64)1000;
+        if (ui->txToDate->date() != ui->txToDate->minimumDate())
+            filter.toTime = QDateTime(ui->txToDate->date().addDays(1)).toMSecsSinceEpoch() / (qint64)1000 - 1;
+
+        if (!ui->txMinAmount->text().isEmpty())
+            filter.minAmount = ui->txMinAmount->text().toDouble();
+        if (!ui->txMaxAmount->text().isEmpty())
+            filter.maxAmount = ui->txMaxAmount->text().toDouble();
+
+        txModel->setFilter(filter);
+    };
+
+    QObject::connect(ui->txSearch,    &QLineEdit::textChanged, fnApplyTxFilter);
+    QObject::connect(ui->txMinAmount, &QLineEdit::textChanged, fnApplyTxFilter);
+    QObject::connect(ui->txMaxAmount, &QLineEdit::textChanged, fnApplyTxFilter);
+    QObject::connect(ui->txFromDate,  &QDateEdit::dateChanged, fnApplyTxFilter);
+    QObject::connect(ui->txToDate,    &QDateEdit::dateChanged, fnApplyTxFilter);
+    QObject::connect(ui->txTypeFilter, QOverload<int>::of(&QComboBox::currentIndexChanged), fnApplyTxFilter);
+
     // Double click opens up memo if one exists
     QObject::connect(ui->transactionsTable, &QTableView::doubleClicked, [=] (auto index) {
         auto txModel = dynamic_cast<TxTableModel *>(ui->transactionsTable->model());
@@ -1002,18 +1163,28 @@ void MainWindow::setupTransactionsTab() {
     });
 }
 
+// Select the address in the receive combo, if it is in the list being shown
+void MainWindow::selectReceiveAddress(const QString& addr) {
+    auto model = dynamic_cast<AddressBalancesModel*>(ui->listRecieveAddresses->model());
+    if (model == nullptr)
+        return;
+
+    int row = model->rowOf(addr);
+    if (row >= 0)
+        ui->listRecieveAddresses->setCurrentIndex(row);
+}
+
 void MainWindow::addNewZaddr(bool sapling) {
 
     rpc->newZaddr(sapling, [=] (json reply) {
         QString addr = QString::fromStdString(reply.get<json::string_t>());
-        // Make sure the RPC class reloads the z-addrs for future use
-        rpc->refreshAddresses();
+        // Make sure the RPC class has the new z-addr for future use
+        rpc->addNewAddress(addr);
 
         // Just double make sure the z-address is still checked
         if (( sapling && ui->rdioZSAddr->isChecked()) ||
             (!sapling && ui->rdioZAddr->isChecked())) {
-            ui->listRecieveAddresses->insertItem(0, addr); 
-            ui->listRecieveAddresses->setCurrentIndex(0);
+            selectReceiveAddress(addr);
 
             ui->statusBar->showMessage(QString::fromStdString("Created new zAddr") %
                                        (sapling ? "(Sapling)" : "(Sprout)"), 
@@ -1023,24 +1194,17 @@ void MainWindow::addNewZaddr(bool sapling) {
 }
 
 
-// Adds sapling or sprout z-addresses to the combo box. Technically, returns a
+// Shows the sapling or sprout z-addresses in the combo box. Technically, returns a
 // lambda, which can be connected to the appropriate signal
 std::function<void(bool)> MainWindow::addZAddrsToComboList(bool sapling) {
     return [=] (bool checked) { 
         if (checked && this->rpc->getAllZAddresses() != nullptr) { 
-            auto addrs = this->rpc->getAllZAddresses();
-            ui->listRecieveAddresses->clear();
-
-            std::for_each(addrs->begin(), addrs->end(), [=] (auto addr) {
-                if ( (sapling &&  Settings::getInstance()->isSaplingAddress(addr)) ||
-                    (!sapling && !Settings::getInstance()->isSaplingAddress(addr))) {
-                    auto bal = rpc->getAllBalances()->value(addr);
-                    ui->listRecieveAddresses->addItem(addr, bal);
-                }
-            }); 
+            // The address lists are kept up to date by the RPC class, so just swap in the right one
+            ui->listRecieveAddresses->setModel(sapling ? rpc->getSaplingAddressesModel() : 
+                                                         rpc->getSproutAddressesModel());
 
             // If z-addrs are empty, then create a new one.
-            if (addrs->isEmpty()) {
+            if (this->rpc->getAllZAddresses()->isEmpty()) {
                 addNewZaddr(sapling);
             }
         } 
@@ -1051,11 +1215,11 @@ void MainWindow::setupRecieveTab() {
     auto addNewTAddr = [=] () {
         rpc->newTaddr([=] (json reply) {
             QString addr = QString::fromStdString(reply.get<json::string_t>());
+            rpc->addNewAddress(addr);
 
             // Just double make sure the t-address is still checked
             if (ui->rdioTAddr->isChecked()) {
-                ui->listRecieveAddresses->insertItem(0, addr);
-                ui->listRecieveAddresses->setCurrentIndex(0);
+                selectReceiveAddress(addr);
 
                 ui->statusBar->showMessage(tr("Created new t-Addr"), 10 * 1000);
             }
@@ -1064,16 +1228,7 @@ void MainWindow::setupRecieveTab() {
 
     auto fnUpdateTAddrCombo = [=] (bool checked) {
         if (checked) {
-            auto utxos = this->rpc->getUTXOs();
-            ui->listRecieveAddresses->clear();
-
-            std::for_each(utxos->begin(), utxos->end(), [=](auto& utxo) {
-                auto addr = utxo.address;
-                if (addr.startsWith("t") && ui->listRecieveAddresses->findText(addr) < 0) {
-                    auto bal = rpc->getAllBalances()->value(addr);
-                    ui->listRecieveAddresses->addItem(addr, bal);
-                }
-            });
+            ui->listRecieveAddresses->setModel(rpc->getTAddressesModel());
         }
     };
 
@@ -1200,12 +1355,10 @@ void MainWindow::setupRecieveTab() {
         }
 
         // Update the UI
-        if (ui->rdioTAddr->isChecked()) {
-            fnUpdateTAddrCombo(true);
-        }
-        else {
-            addZAddrsToComboList(ui->rdioZSAddr->isChecked())(true);
-        }
+        rpc->getTAddressesModel()->labelsChanged();
+        rpc->getSaplingAddressesModel()->labelsChanged();
+        rpc->getSproutAddressesModel()->labelsChanged();
+        rpc->getPayFromModel()->labelsChanged();
 
         // Show the user feedback
         if (!info.isEmpty()) {
@@ -1231,4 +1384,8 @@ MainWindow::~MainWindow()
 
     delete loadingMovie;
     delete logger;
+
+    // Write out anything that is still pending before the app exits
+    WalletStore::getInstance()->commit();
+    IOExecutor::getInstance()->shutdown();
 }   
@@ -40,6 +40,7 @@ public:
     void updateLabelsAutoComplete();
 
     void setDefaultPayFrom();
+    void updatePayFromBalance();
 
     Ui::MainWindow*     ui;
 
@@ -80,6 +81,7 @@ private:
     void amountChanged (int number, const QString& text);
 
     void addNewZaddr(bool sapling);
+    void selectReceiveAddress(const QString& addr);
     std::function<void(bool)> addZAddrsToComboList(bool sapling);
 
     void memoButtonClicked(int number, bool includeReplyTo = false);
@@ -95,6 +97,8 @@ private:
     void exportKeys(QString addr = "");
     void backupWalletDat();
     void exportTransactions();
+    void exportSyncMetrics();
+    void verifyParams();
 
     void doImport(QList<QString>* keys);
 
@@ -0,0 +1,469 @@
+#include "paramsdownloader.h"
+#include "ioexecutor.h"
+#include "paramsverifier.h"
+
+ParamsDownloader::ParamsDownloader(QObject* parent, const QString& dir, const QList<QUrl>& urls,
+                                   int maxParallel, int segmentsPerFile) :
+        QObject(parent), dir(dir), maxParallel(qMax(1, maxParallel)), segmentsPerFile(qMax(1, segmentsPerFile)) {
+    for (const auto& url : urls) {
+        queue.enqueue(url);
+    }
+    client = new QNetworkAccessManager(this);
+}
+
+ParamsDownloader::~ParamsDownloader() {
+    qDeleteAll(files);
+}
+
+void ParamsDownloader::start(std::function<void(const Progress&)> progress, std::function<void(QString)> done) {
+    progressCb = progress;
+    doneCb     = done;
+
+    elapsed.start();
+    lastReport.start();
+
+    startNext();
+}
+
+// Start downloading files until maxParallel are active
+void ParamsDownloader::startNext() {
+    while (!failed && activeFiles < maxParallel && !queue.isEmpty()) {
+        auto f = new FileState();
+        f->url      = queue.dequeue();
+        f->name     = QDir(dir).filePath(QFileInfo(f->url.path()).fileName());
+        f->partName = f->name % ".part";
+
+        if (QFile::exists(f->name)) {
+            delete f;
+            continue;
+        }
+
+        files.push_back(f);
+        activeFiles++;
+        probe(f);
+    }
+
+    if (!failed && activeFiles == 0 && queue.isEmpty()) {
+        reportProgress(true);
+        doneCb(QString());
+    }
+}
+
+// Find out how big the file is, and if the server can send parts of it
+void ParamsDownloader::probe(FileState* f) {
+    QNetworkRequest request(f->url);
+    request.setAttribute(QNetworkRequest::FollowRedirectsAttribute, true);
+
+    auto reply = client->head(request);
+    QObject::connect(reply, &QNetworkReply::finished, [=] () {
+        reply->deleteLater();
+        if (failed)
+            return;
+
+        // If the HEAD request doesn't work, just download the whole file in one go
+        if (reply->error() == QNetworkReply::NoError) {
+            bool ok;
+            auto length = reply->header(QNetworkRequest::ContentLengthHeader).toLongLong(&ok);
+            f->total  = ok && length > 0 ? length : -1;
+            f->ranges = f->total > 0 && reply->rawHeader("Accept-Ranges").trimmed() == "bytes";
+        }
+        if (f->total > 0)
+            bytesTotal += f->total;
+
+        planSegments(f);
+
+        bool truncate = f->segments.size() == 1 && f->segments[0].done == 0;
+        f->file = new QFile(f->partName);
+        if (!f->file->open(truncate ? QIODevice::WriteOnly | QIODevice::Truncate : QIODevice::ReadWrite)) {
+            fail(QObject::tr("Couldn't open ") % f->partName % QObject::tr(" for writing"));
+            return;
+        }
+
+        // A stale .part that is longer than the file would keep its tail after the segments are written
+        if (f->total > 0 && f->file->size() > f->total)
+            f->file->resize(f->total);
+
+        // Hash whatever is already in a resumed .part file before the new data is written after it. That
+        // can be hundreds of MB, so it is read on a thread of its own, and the download only starts after.
+        if (f->segments.size() == 1) {
+            f->hash = std::make_shared<QCryptographicHash>(QCryptographicHash::Sha256);
+            if (f->segments[0].done > 0) {
+                auto hash = f->hash;
+                auto partName = f->partName;
+                auto length = f->segments[0].done;
+                pendingTasks++;
+                IOExecutor::getInstance()->runAside([=] () { ParamsVerifier::hashFile(partName, *hash, length); }, [=] () {
+                    pendingTasks--;
+                    if (failed) {
+                        reportFailure();
+                        return;
+                    }
+                    startSegments(f);
+                });
+                return;
+            }
+        }
+
+        startSegments(f);
+    });
+}
+
+void ParamsDownloader::startSegments(FileState* f) {
+    for (int i = 0; i < f->segments.size(); i++) {
+        bytesDone += f->segments[i].done;
+        startSegment(f, i);
+    }
+    if (f->active == 0)
+        fileFinished(f);
+}
+
+/**
+ * Work out which byte ranges still need to be fetched. A saved segment state or an existing .part file
+ * is resumed if the server supports ranges, otherwise the file is downloaded from the start.
+ */
+void ParamsDownloader::planSegments(FileState* f) {
+    f->segments.clear();
+
+    if (f->ranges && loadState(stateName(f), f->total, f->segments))
+        return;
+    QFile::remove(stateName(f));
+
+    qint64 partSize = QFileInfo(f->partName).exists() ? QFileInfo(f->partName).size() : 0;
+    if (f->ranges && partSize > 0 && partSize <= f->total) {
+        f->segments.push_back(Segment{0, f->total - 1, partSize, nullptr});
+        return;
+    }
+
+    int count = f->ranges ? (int)qMin<qint64>(segmentsPerFile, f->total / minSegmentSize) : 1;
+    if (count <= 1) {
+        f->segments.push_back(Segment{0, f->total > 0 ? f->total - 1 : -1, 0, nullptr});
+        return;
+    }
+
+    qint64 size = f->total / count;
+    for (int i = 0; i < count; i++) {
+        qint64 start = i * size;
+        qint64 end   = i == count - 1 ? f->total - 1 : start + size - 1;
+        f->segments.push_back(Segment{start, end, 0, nullptr});
+    }
+    saveState(stateName(f), f->total, f->segments);
+}
+
+void ParamsDownloader::startSegment(FileState* f, int i) {
+    Segment& seg = f->segments[i];
+    if (seg.end >= 0 && seg.start + seg.done > seg.end)
+        return;     // Already complete
+
+    QNetworkRequest request(f->url);
+    request.setAttribute(QNetworkRequest::FollowRedirectsAttribute, true);
+
+    seg.ranged = f->segments.size() > 1 || seg.done > 0;
+    if (seg.ranged) {
+        request.setRawHeader("Range", "bytes=" % QByteArray::number(seg.start + seg.done) % "-" %
+                                      (seg.end >= 0 ? QByteArray::number(seg.end) : QByteArray()));
+    }
+
+    f->active++;
+    seg.reply = client->get(request);
+
+    // Lets the socket stop reading while the reply isn't being read
+    seg.reply->setReadBufferSize(readBufferSize);
+
+    connectSegment(f, i);
+}
+
+void ParamsDownloader::connectSegment(FileState* f, int i) {
+    auto reply = f->segments[i].reply;
+    QObject::connect(reply, &QNetworkReply::readyRead, this, [=] () { readSegment(f, i, false); });
+    QObject::connect(reply, &QNetworkReply::finished,  this, [=] () { replyFinished(f, i); });
+}
+
+/**
+ * Queue what the segment's reply has buffered to be written. Unless force is set, nothing is read
+ * while too much is already waiting to be written; resumeReading() picks it up once the writes
+ * drain. Returns false if the reply no longer belongs to this segment, because the download failed
+ * or started over as a single stream.
+ */
+bool ParamsDownloader::readSegment(FileState* f, int i, bool force) {
+    auto reply = f->segments[i].reply;
+    if (failed || reply == nullptr)
+        return false;
+
+    // A server that ignores the range sends the whole file from the start
+    if (f->segments[i].ranged && reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() == 200) {
+        restartAsSingleStream(f, i);
+        return false;
+    }
+
+    if (!force && queuedBytes >= maxQueuedBytes)
+        return true;
+
+    auto bytes = reply->readAll();
+    if (bytes.isEmpty())
+        return true;
+
+    Segment& s = f->segments[i];
+    qint64 pos = s.start + s.done;
+    s.done += bytes.size();
+
+    auto file = f->file;
+    auto hash = f->hash;
+    auto size = bytes.size();
+    queuedBytes += size;
+    IOExecutor::getInstance()->submit([=] () {
+        file->seek(pos);
+        file->write(bytes);
+        if (hash)
+            hash->addData(bytes);
+    }, [=] () {
+        queuedBytes -= size;
+        if (queuedBytes < maxQueuedBytes / 2)
+            resumeReading();
+    });
+
+    // Remember how far the segments got, after the data they cover has been written
+    f->unsaved += bytes.size();
+    if (f->segments.size() > 1 && f->unsaved >= stateInterval) {
+        f->unsaved = 0;
+        auto name = stateName(f), total = f->total;
+        auto segments = f->segments;
+        IOExecutor::getInstance()->submit([=] () { saveState(name, total, segments); });
+    }
+
+    bytesDone    += bytes.size();
+    sessionBytes += bytes.size();
+    reportProgress(false);
+    return true;
+}
+
+// Read the replies that were left unread while the writes were catching up
+void ParamsDownloader::resumeReading() {
+    for (auto f : files) {
+        for (int i = 0; i < f->segments.size() && !failed; i++) {
+            auto reply = f->segments[i].reply;
+            if (reply != nullptr && reply->bytesAvailable() > 0)
+                readSegment(f, i, false);
+        }
+    }
+}
+
+void ParamsDownloader::replyFinished(FileState* f, int i) {
+    auto reply = f->segments[i].reply;
+
+    // The rest of the data can still be in the reply's buffer, which is at most readBufferSize
+    if (!failed && reply->error() == QNetworkReply::NoError && !readSegment(f, i, true) && !failed)
+        return;     // Started over as a single stream, which has taken this reply over
+
+    reply->deleteLater();
+    f->segments[i].reply = nullptr;
+    if (failed)
+        return;
+
+    if (reply->error() != QNetworkReply::NoError) {
+        fail(reply->errorString());
+        return;
+    }
+
+    segmentFinished(f, i);
+}
+
+/**
+ * The server answered a range request with the whole file, so it can't do ranges after all. Drop the
+ * other segments and what was already downloaded, and keep this reply as a single stream from the start.
+ */
+void ParamsDownloader::restartAsSingleStream(FileState* f, int i) {
+    auto reply = f->segments[i].reply;
+    for (auto& seg : f->segments) {
+        bytesDone -= seg.done;
+        if (seg.reply == nullptr)
+            continue;
+
+        QObject::disconnect(seg.reply, nullptr, this, nullptr);
+        if (seg.reply != reply) {
+            seg.reply->abort();
+            seg.reply->deleteLater();
+        }
+    }
+
+    f->ranges  = false;
+    f->segments.clear();
+    f->segments.push_back(Segment{0, f->total > 0 ? f->total - 1 : -1, 0, reply});
+    f->active  = 1;
+    f->unsaved = 0;
+    f->hash    = std::make_shared<QCryptographicHash>(QCryptographicHash::Sha256);
+
+    // After whatever was already queued for the old segments has been written
+    auto file  = f->file;
+    auto state = stateName(f);
+    IOExecutor::getInstance()->submit([=] () {
+        file->resize(0);
+        QFile::remove(state);
+    });
+
+    connectSegment(f, 0);
+    if (reply->isFinished())
+        replyFinished(f, 0);
+    else
+        readSegment(f, 0, false);
+}
+
+void ParamsDownloader::segmentFinished(FileState* f, int i) {
+    const Segment& seg = f->segments[i];
+    if (seg.end >= 0 && seg.start + seg.done != seg.end + 1) {
+        fail(QObject::tr("Download of ") % f->url.toString() % QObject::tr(" was incomplete"));
+        return;
+    }
+
+    f->active--;
+    if (f->active == 0)
+        fileFinished(f);
+}
+
+// Check the digest and rename the .part file once everything queued for it has been written. A
+// segmented file has to be read again to hash it, so that is done on a thread of its own rather
+// than holding up the I/O queue.
+void ParamsDownloader::fileFinished(FileState* f) {
+    auto file     = f->file;
+    auto hash     = f->hash;
+    auto name     = f->name;
+    auto partName = f->partName;
+    auto state    = stateName(f);
+    auto error    = std::make_shared<QString>();
+
+    // fail() leaves the file alone from here on, and waits for the check before reporting
+    f->checking = true;
+    pendingTasks++;
+    IOExecutor::getInstance()->submit([=] () {
+        file->close();
+        QFile::remove(state);
+    }, [=] () {
+        IOExecutor::getInstance()->runAside([=] () {
+            auto baseName = QFileInfo(name).fileName();
+            auto expected = ParamsVerifier::expectedDigest(baseName);
+            if (!expected.isEmpty()) {
+                QCryptographicHash whole(QCryptographicHash::Sha256);
+                if (!hash)
+                    ParamsVerifier::hashFile(partName, whole);
+
+                if ((hash ? hash->result() : whole.result()).toHex() != expected) {
+                    file->remove();
+                    *error = QObject::tr("The downloaded ") % baseName % QObject::tr(" is corrupt");
+                    return;
+                }
+            }
+
+            if (!file->rename(name)) {
+                *error = QObject::tr("Couldn't rename ") % partName % QObject::tr(" to ") % name;
+                return;
+            }
+
+            if (!expected.isEmpty())
+                ParamsVerifier::stamp(QFileInfo(name).absolutePath(), baseName, expected);
+        }, [=] () {
+            delete f->file;
+            f->file     = nullptr;
+            f->checking = false;
+            pendingTasks--;
+
+            if (failed) {
+                reportFailure();
+                return;
+            }
+
+            if (!error->isEmpty()) {
+                fail(*error);
+                return;
+            }
+
+            activeFiles--;
+            startNext();
+        });
+    });
+}
+
+// Stop all the downloads, keeping the .part files (and the segment state) so they can be resumed
+void ParamsDownloader::fail(const QString& error) {
+    if (failed)
+        return;
+    failed = true;
+
+    for (auto f : files) {
+        for (auto& seg : f->segments) {
+            if (seg.reply != nullptr)
+                seg.reply->abort();
+        }
+
+        if (f->file == nullptr || f->checking)
+            continue;
+
+        auto file = f->file;
+        f->file   = nullptr;
+        auto name = stateName(f), total = f->total;
+        auto segments = f->segments;
+        IOExecutor::getInstance()->submit([=] () {
+            file->close();
+            if (segments.size() > 1)
+                saveState(name, total, segments);
+            delete file;
+        });
+    }
+
+    failure = error;
+    pendingTasks++;
+    IOExecutor::getInstance()->submit([] () {}, [=] () {
+        pendingTasks--;
+        reportFailure();
+    });
+}
+
+// Call done once the files are closed and nothing that is still running uses them or this
+void ParamsDownloader::reportFailure() {
+    if (pendingTasks > 0 || !doneCb)
+        return;
+
+    auto cb = doneCb;
+    doneCb  = nullptr;
+    cb(failure);
+}
+
+void ParamsDownloader::reportProgress(bool force) {
+    if (!force && lastReport.elapsed() < 250)
+        return;
+    lastReport.restart();
+
+    int remaining = queue.size() + activeFiles;
+    double speed  = elapsed.elapsed() > 0 ? sessionBytes * 1000.0 / elapsed.elapsed() : 0;
+    progressCb(Progress{bytesDone, bytesTotal, speed, remaining});
+}
+
+void ParamsDownloader::saveState(const QString& fileName, qint64 total, const QList<Segment>& segments) {
+    QJsonArray arr;
+    for (const auto& seg : segments) {
+        arr.push_back(QJsonArray{ QString::number(seg.start), QString::number(seg.end), QString::number(seg.done) });
+    }
+    QJsonObject obj{ {"total", QString::number(total)}, {"segments", arr} };
+
+    QSaveFile file(fileName);
+    if (file.open(QIODevice::WriteOnly)) {
+        file.write(QJsonDocument(obj).toJson(QJsonDocument::Compact));
+        file.commit();
+    }
+}
+
+bool ParamsDownloader::loadState(const QString& fileName, qint64 total, QList<Segment>& segments) {
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    auto obj = QJsonDocument::fromJson(file.readAll()).object();
+    if (obj["total"].toString().toLongLong() != total)
+        return false;
+
+    for (auto v : obj["segments"].toArray()) {
+        auto arr = v.toArray();
+        segments.push_back(Segment{arr[0].toString().toLongLong(), arr[1].toString().toLongLong(),
+                                   arr[2].toString().toLongLong(), nullptr});
+    }
+
+    return !segments.isEmpty();
+}
@@ -0,0 +1,113 @@
+#ifndef PARAMSDOWNLOADER_H
+#define PARAMSDOWNLOADER_H
+
+#include "precompiled.h"
+
+/**
+ * Downloads the proving parameters. Up to maxParallel files are fetched at once, and when the
+ * server supports ranges, each large file is split into segmentsPerFile parallel range requests.
+ *
+ * Each file is written to <name>.part and renamed when it is complete. An interrupted download is
+ * resumed from the .part file with a Range request. Segmented downloads also keep a small
+ * <name>.part.state file with how far each segment got.
+ *
+ * Files that are written in order are hashed as the data is written, so checking them against
+ * ParamsVerifier's digests doesn't need another pass over the file. Segmented files are hashed
+ * once they are complete. A file with the wrong digest is deleted and the download fails.
+ *
+ * Data is written on the IOExecutor thread. If the disk can't keep up, the replies are left unread
+ * until the queued writes drain, so the network is throttled instead of the data piling up in memory.
+ * A server that answers a range request with the whole file is downloaded in a single stream instead.
+ */
+class ParamsDownloader : public QObject
+{
+    Q_OBJECT
+public:
+    struct Progress {
+        qint64  done;               // Bytes on disk, across all the files, including resumed ones
+        qint64  total;              // Of the files whose size is known so far
+        double  bytesPerSec;        // Fetched in this session
+        int     filesRemaining;
+    };
+
+    ParamsDownloader(QObject* parent, const QString& dir, const QList<QUrl>& urls, int maxParallel, int segmentsPerFile);
+    ~ParamsDownloader();
+
+    // done is called with an empty string once all the files are downloaded, or with the first error
+    void start(std::function<void(const Progress&)> progress, std::function<void(QString)> done);
+
+private:
+    struct Segment {
+        qint64          start;
+        qint64          end;        // Inclusive, or -1 if the size isn't known
+        qint64          done;       // Bytes written so far
+        QNetworkReply*  reply;
+        bool            ranged      = false;    // The request asked for a range
+    };
+
+    struct FileState {
+        QUrl            url;
+        QString         name;
+        QString         partName;
+        qint64          total       = -1;
+        bool            ranges      = false;
+        QFile*          file        = nullptr;
+        QList<Segment>  segments;
+        int             active      = 0;
+        qint64          unsaved     = 0;    // Bytes written since the state file was last saved
+        bool            checking    = false;    // fileFinished owns the file while it checks and renames it
+
+        // SHA-256 of a single segment file, fed as it is written. Only used on the I/O thread.
+        std::shared_ptr<QCryptographicHash> hash;
+    };
+
+    void    startNext();
+    void    probe(FileState* f);
+    void    planSegments(FileState* f);
+    void    startSegments(FileState* f);
+    void    startSegment(FileState* f, int i);
+    void    connectSegment(FileState* f, int i);
+    bool    readSegment(FileState* f, int i, bool force);
+    void    replyFinished(FileState* f, int i);
+    void    restartAsSingleStream(FileState* f, int i);
+    void    resumeReading();
+    void    segmentFinished(FileState* f, int i);
+    void    fileFinished(FileState* f);
+    void    fail(const QString& error);
+    void    reportFailure();
+    void    reportProgress(bool force);
+
+    static QString  stateName(const FileState* f) { return f->partName % ".state"; }
+    static void     saveState(const QString& fileName, qint64 total, const QList<Segment>& segments);
+    static bool     loadState(const QString& fileName, qint64 total, QList<Segment>& segments);
+
+    QString                 dir;
+    QQueue<QUrl>            queue;
+    QList<FileState*>       files;
+    QNetworkAccessManager*  client;
+
+    int     maxParallel;
+    int     segmentsPerFile;
+    int     activeFiles     = 0;
+    bool    failed          = false;
+    QString failure;
+    int     pendingTasks    = 0;    // Flushes and checks still running. The caller deletes this once done is called.
+
+    qint64  bytesDone       = 0;
+    qint64  bytesTotal      = 0;
+    qint64  sessionBytes    = 0;
+    qint64  queuedBytes     = 0;    // Read from the network, but not written yet
+
+    QElapsedTimer   elapsed;
+    QElapsedTimer   lastReport;
+
+    std::function<void(const Progress&)>    progressCb;
+    std::function<void(QString)>            doneCb;
+
+    static const qint64 minSegmentSize  = 16 * 1024 * 1024;
+    static const qint64 stateInterval   = 8 * 1024 * 1024;     // Save the segment state this often
+    static const qint64 maxQueuedBytes  = 32 * 1024 * 1024;    // Stop reading until the writes drain
+    static const qint64 readBufferSize  = 1024 * 1024;         // Per reply
+};
+
+#endif // PARAMSDOWNLOADER_H
@@ -0,0 +1,134 @@
+#include "paramsverifier.h"
+
+std::mutex ParamsVerifier::stampLock;
+
+// The same digests commercium-fetch-params checks
+static const struct {
+    const char* name;
+    const char* sha256;
+} knownParams[] = {
+    { "sapling-output.params",  "2f0ebbcbb9bb0bcffe95a397e7eba89c29eb4dde6191c339db88570e3f3fb0e4" },
+    { "sapling-spend.params",   "8e48ffd23abb3a5fd9c5589204f32d9c31285a04b78096ba40a79b75677efc13" },
+    { "sprout-proving.key",     "8bc20a7f013b2b58970cddd2e7ea028975c88ae7ceb9259a5344a16bc2c0eef7" },
+    { "sprout-verifying.key",   "4bd498dae0aacfd8e98dc306338d017d9c08dd0918ead18172bd0aec2fc5df82" },
+    { "sprout-groth16.params",  "b685d700c60328498fbde589c8c7c484c722b788b265b72af448a5bf0ee55b50" },
+};
+
+QString ParamsVerifier::paramsLocation() {
+#ifdef Q_OS_LINUX
+    auto paramsLocation = QDir(QDir(QStandardPaths::writableLocation(QStandardPaths::HomeLocation)).filePath(".zcash-params"));
+#elif defined(Q_OS_DARWIN)
+    auto paramsLocation = QDir(QDir(QStandardPaths::writableLocation(QStandardPaths::HomeLocation)).filePath("Library/Application Support/ZcashParams"));
+#else
+    auto paramsLocation = QDir(QDir(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)).filePath("../../ZcashParams"));
+#endif
+
+    return paramsLocation.absolutePath();
+}
+
+QStringList ParamsVerifier::fileNames() {
+    QStringList names;
+    for (const auto& p : knownParams) {
+        names.push_back(p.name);
+    }
+    return names;
+}
+
+QByteArray ParamsVerifier::expectedDigest(const QString& name) {
+    for (const auto& p : knownParams) {
+        if (name == QLatin1String(p.name))
+            return QByteArray(p.sha256);
+    }
+    return QByteArray();
+}
+
+bool ParamsVerifier::isStamped(const QString& dir, const QString& name) {
+    QFileInfo info(QDir(dir).filePath(name));
+    if (!info.exists())
+        return false;
+
+    QJsonObject entry;
+    {
+        std::lock_guard<std::mutex> guard(stampLock);
+        QFile file(stampName(dir));
+        if (!file.open(QIODevice::ReadOnly))
+            return false;
+        entry = QJsonDocument::fromJson(file.readAll()).object()[name].toObject();
+    }
+
+    return entry["size"].toString().toLongLong() == info.size() &&
+           entry["mtime"].toString().toLongLong() == info.lastModified().toMSecsSinceEpoch() &&
+           entry["sha256"].toString().toLatin1() == expectedDigest(name);
+}
+
+bool ParamsVerifier::stamp(const QString& dir, const QString& name, const QByteArray& digest) {
+    bool ok = !digest.isEmpty() && digest == expectedDigest(name);
+    QFileInfo info(QDir(dir).filePath(name));
+
+    std::lock_guard<std::mutex> guard(stampLock);
+
+    QJsonObject stamps;
+    QFile in(stampName(dir));
+    if (in.open(QIODevice::ReadOnly)) {
+        stamps = QJsonDocument::fromJson(in.readAll()).object();
+        in.close();
+    }
+
+    // A file that doesn't match loses its old stamp, so it gets checked again
+    if (ok) {
+        stamps[name] = QJsonObject{ {"size",   QString::number(info.size())},
+                                    {"mtime",  QString::number(info.lastModified().toMSecsSinceEpoch())},
+                                    {"sha256", QString::fromLatin1(digest)} };
+    } else {
+        stamps.remove(name);
+    }
+
+    QSaveFile out(stampName(dir));
+    if (out.open(QIODevice::WriteOnly)) {
+        out.write(QJsonDocument(stamps).toJson());
+        out.commit();
+    }
+
+    return ok;
+}
+
+bool ParamsVerifier::hashFile(const QString& path, QCryptographicHash& hash, qint64 length) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QByteArray buf(1024 * 1024, Qt::Uninitialized);
+    qint64 remaining = length < 0 ? file.size() : length;
+    while (remaining > 0) {
+        auto read = file.read(buf.data(), qMin<qint64>(buf.size(), remaining));
+        if (read <= 0)
+            return false;
+
+        hash.addData(buf.constData(), (int)read);
+        remaining -= read;
+    }
+
+    return true;
+}
+
+QStringList ParamsVerifier::verify(const QString& dir, const QStringList& names) {
+    // SHA-256 of a single file can't be split up, so the files are hashed side by side
+    std::vector<std::future<bool>> workers;
+    for (const auto& name : names) {
+        workers.push_back(std::async(std::launch::async, [=] () {
+            QCryptographicHash hash(QCryptographicHash::Sha256);
+            if (!hashFile(QDir(dir).filePath(name), hash))
+                return stamp(dir, name, QByteArray());
+
+            return stamp(dir, name, hash.result().toHex());
+        }));
+    }
+
+    QStringList bad;
+    for (int i = 0; i < names.size(); i++) {
+        if (!workers[i].get())
+            bad.push_back(names[i]);
+    }
+
+    return bad;
+}
@@ -0,0 +1,41 @@
+#ifndef PARAMSVERIFIER_H
+#define PARAMSVERIFIER_H
+
+#include "precompiled.h"
+
+/**
+ * Checks the proving parameters against their published SHA-256 digests. Hashing all of them means
+ * reading about 1.7 GB, so each file that checks out is recorded in a stamp file in the params
+ * directory, together with its size and modification time. As long as those haven't changed, the
+ * file is trusted without reading it again.
+ */
+class ParamsVerifier {
+public:
+    // Where commerciumd looks for the params
+    static QString      paramsLocation();
+
+    // The params commerciumd needs
+    static QStringList  fileNames();
+
+    // Hex SHA-256 of the named file, or empty if it isn't one of the params
+    static QByteArray   expectedDigest(const QString& name);
+
+    // True if the file was verified before and hasn't changed since. Doesn't read the file.
+    static bool         isStamped(const QString& dir, const QString& name);
+
+    // Record the file, as it is on disk now, as verified with this digest. Returns false if the digest is wrong.
+    static bool         stamp(const QString& dir, const QString& name, const QByteArray& digest);
+
+    // Add the first length bytes of the file (or all of it) to the hash
+    static bool         hashFile(const QString& path, QCryptographicHash& hash, qint64 length = -1);
+
+    // Hash the files in parallel, one thread each, and stamp the good ones. Returns the ones that are wrong.
+    static QStringList  verify(const QString& dir, const QStringList& names);
+
+private:
+    static QString      stampName(const QString& dir) { return QDir(dir).filePath(".cmm-qt-wallet-verified"); }
+
+    static std::mutex   stampLock;
+};
+
+#endif // PARAMSVERIFIER_H
@@ -0,0 +1,166 @@
+#include "paymentqrbatch.h"
+#include "addressvalidator.h"
+#include "qrcodelabel.h"
+#include "settings.h"
+
+/**
+ * Read rows of address,amount,memo. The memo is everything after the second comma, so it may contain
+ * commas itself. An empty amount means the request has no amount. A first line whose amount isn't a
+ * number is taken to be a header and skipped.
+ */
+QList<PaymentQrBatch::Request> PaymentQrBatch::readCsv(const QString& fileName, QString& error) {
+    QList<Request> requests;
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        error = file.errorString();
+        return requests;
+    }
+
+    QTextStream in(&file);
+    in.setCodec("UTF-8");
+    QString line;
+    for (int row = 1; in.readLineInto(&line); row++) {
+        if (line.trimmed().isEmpty())
+            continue;
+
+        int first  = line.indexOf(',');
+        int second = first < 0 ? -1 : line.indexOf(',', first + 1);
+
+        bool ok = true;
+        Request r{row, line.left(first).trimmed(), 0, ""};
+        if (first >= 0) {
+            auto amount = line.mid(first + 1, second < 0 ? -1 : second - first - 1).trimmed();
+            if (!amount.isEmpty())
+                r.amount = amount.toDouble(&ok);
+            r.memo = second < 0 ? QString() : line.mid(second + 1).trimmed();
+        }
+
+        if (!ok && row == 1)
+            continue;   // Header
+
+        // Rows that don't parse are still returned, so they are counted as failed
+        if (!ok)
+            r.amount = -1;
+
+        requests.push_back(r);
+    }
+
+    return requests;
+}
+
+// A ZIP-321 style payment URI. The memo is base64url encoded, and is only allowed for z-Addrs.
+QString PaymentQrBatch::paymentUri(const Request& request) {
+    QString uri = "commercium:" % request.address;
+
+    QStringList params;
+    if (request.amount > 0)
+        params << "amount=" % Settings::getDecimalString(request.amount);
+
+    auto type = AddressValidator::classify(request.address);
+    if (!request.memo.isEmpty() && (type == AddressValidator::Sapling || type == AddressValidator::Sprout)) {
+        auto memo = request.memo.toUtf8().toBase64(QByteArray::Base64UrlEncoding | QByteArray::OmitTrailingEquals);
+        params << "memo=" % QString::fromLatin1(memo);
+    }
+
+    if (!params.isEmpty())
+        uri += "?" % params.join("&");
+
+    return uri;
+}
+
+// Render the text as a 1-bit image, with a white quiet zone around it
+QImage PaymentQrBatch::render(const QString& text, int moduleSize) {
+    qrcodegen::QrCode qr = qrcodegen::QrCode::encodeText(text.toUtf8().constData(), qrcodegen::QrCode::Ecc::LOW);
+
+    // One pixel per module, then a nearest-neighbour scale up
+    QImage image = QRCodeLabel::moduleImage(qr, quietZone);
+    return image.scaled(image.width() * moduleSize, image.height() * moduleSize, Qt::IgnoreAspectRatio, Qt::FastTransformation);
+}
+
+bool PaymentQrBatch::writeOne(const Request& request, const QString& outDir, Format format) {
+    if (request.amount < 0 || !AddressValidator::isValid(request.address))
+        return false;
+
+    auto name = QDir(outDir).filePath(QString("%1-%2").arg(request.row, 6, 10, QChar('0')).arg(request.address.left(16)));
+    auto uri  = paymentUri(request);
+
+    try {
+        if (format == SVG) {
+            auto qr  = qrcodegen::QrCode::encodeText(uri.toUtf8().constData(), qrcodegen::QrCode::Ecc::LOW);
+            auto svg = qr.toSvgString(quietZone);
+
+            QFile file(name % ".svg");
+            if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+                return false;
+            return file.write(svg.data(), svg.size()) == (qint64)svg.size();
+        } else {
+            return render(uri, moduleSize).save(name % ".png", "PNG");
+        }
+    } catch (const std::exception&) {
+        // The URI is too long to fit in a QR code
+        return false;
+    }
+}
+
+PaymentQrBatch::Result PaymentQrBatch::generate(const QList<Request>& requests, const QString& outDir, Format format) {
+    QDir().mkpath(outDir);
+
+    QElapsedTimer timer;
+    timer.start();
+
+    std::atomic<int> written(0), failed(0);
+    auto fnWriteRange = [&] (int start, int end) {
+        for (int i = start; i < end; i++) {
+            if (writeOne(requests[i], outDir, format))
+                written++;
+            else
+                failed++;
+        }
+    };
+
+    // Split the rows evenly across the cores. Each code is independent, so there is nothing to share.
+    int threads   = qMax(1, qMin(QThread::idealThreadCount(), requests.size()));
+    int chunkSize = requests.isEmpty() ? 0 : (requests.size() + threads - 1) / threads;
+
+    std::vector<std::future<void>> workers;
+    for (int start = chunkSize; start < requests.size(); start += chunkSize) {
+        workers.push_back(std::async(std::launch::async, fnWriteRange, start, qMin(start + chunkSize, requests.size())));
+    }
+    fnWriteRange(0, qMin(chunkSize, requests.size()));
+
+    for (auto& w : workers) {
+        w.wait();
+    }
+
+    Result result;
+    result.written   = written;
+    result.failed    = failed;
+    result.elapsedMs = timer.elapsed();
+    return result;
+}
+
+int PaymentQrBatch::runCommandLine(const QStringList& args) {
+    // args are: program --qr-batch input.csv outdir [--svg]
+    if (args.size() < 4) {
+        std::cerr << "Usage: " << args.value(0).toStdString() << " --qr-batch <requests.csv> <output dir> [--svg]" << std::endl;
+        return 1;
+    }
+
+    QString error;
+    auto requests = readCsv(args[2], error);
+    if (!error.isEmpty()) {
+        std::cerr << "Couldn't read " << args[2].toStdString() << ": " << error.toStdString() << std::endl;
+        return 1;
+    }
+
+    auto format = args.contains("--svg") ? SVG : PNG;
+    auto result = generate(requests, args[3], format);
+
+    double perSec = result.elapsedMs > 0 ? result.written * 1000.0 / result.elapsedMs : result.written;
+    std::cout << "Wrote " << result.written << " QR codes to " << args[3].toStdString()
+              << " (" << result.failed << " failed) in " << result.elapsedMs << " ms, "
+              << QString::number(perSec, 'f', 1).toStdString() << " codes/sec" << std::endl;
+
+    return result.failed == 0 ? 0 : 2;
+}
@@ -0,0 +1,48 @@
+#ifndef PAYMENTQRBATCH_H
+#define PAYMENTQRBATCH_H
+
+#include "precompiled.h"
+
+/**
+ * Generates payment request QR codes in bulk, e.g. one per invoice. Reads a CSV of address, amount
+ * and memo, turns each row into a payment URI, and encodes and writes them in parallel. Only QtCore
+ * and QImage are used, so it runs without a display:
+ *
+ *      cmm-qt-wallet --qr-batch requests.csv outdir [--svg]
+ */
+class PaymentQrBatch {
+public:
+    enum Format {
+        PNG,
+        SVG
+    };
+
+    struct Request {
+        int     row;
+        QString address;
+        double  amount;
+        QString memo;
+    };
+
+    struct Result {
+        int     written     = 0;
+        int     failed      = 0;
+        qint64  elapsedMs   = 0;
+    };
+
+    static QList<Request>   readCsv(const QString& fileName, QString& error);
+    static QString          paymentUri(const Request& request);
+    static QImage           render(const QString& text, int moduleSize);
+    static Result           generate(const QList<Request>& requests, const QString& outDir, Format format);
+
+    // Entry point for --qr-batch. Returns the process exit code.
+    static int              runCommandLine(const QStringList& args);
+
+private:
+    static bool             writeOne(const Request& request, const QString& outDir, Format format);
+
+    static const int        moduleSize  = 8;    // Pixels per module in the PNGs
+    static const int        quietZone   = 4;    // Modules of white border, as the QR spec requires
+};
+
+#endif // PAYMENTQRBATCH_H
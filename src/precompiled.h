@@ -6,6 +6,13 @@
 #include <cstdlib>
 #include <ctime>
 #include <cmath>
+#include <cstring>
+#include <atomic>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
 
 #include <QtGlobal>
 
@@ -19,13 +26,16 @@
 #include <QClipboard>
 #include <QStringBuilder>
 #include <QAbstractItemModel>
+#include <QAbstractListModel>
 #include <QTableView>
 #include <QHeaderView>
 #include <QMessageBox>
 #include <QCheckBox>
 #include <QComboBox>
 #include <QScrollBar>
+#include <QProgressBar>
 #include <QPainter>
+#include <QCache>
 #include <QMovie>
 #include <QPair>
 #include <QDir>
@@ -33,13 +43,20 @@
 #include <QCompleter>
 #include <QDateTime>
 #include <QTimer>
+#include <QElapsedTimer>
+#include <QThread>
 #include <QSettings>
 #include <QStyle>
 #include <QFile>
+#include <QSaveFile>
+#include <QCryptographicHash>
+#include <QtEndian>
 #include <QTemporaryFile>
 #include <QErrorMessage>
 #include <QApplication>
 #include <QStandardPaths>
+#include <QStorageInfo>
+#include <QSysInfo>
 #include <QMainWindow>
 #include <QPushButton>
 #include <QLabel>
@@ -50,6 +67,7 @@
 #include <QUrl>
 #include <QQueue>
 #include <QProcess>
+#include <QRegularExpression>
 #include <QDesktopServices>
 #include <QtNetwork/QNetworkRequest>
 #include <QtNetwork/QNetworkAccessManager>
@@ -1,5 +1,7 @@
 #include "qrcodelabel.h"
 
+QCache<QString, QImage> QRCodeLabel::imageCache(64);
+
 QRCodeLabel::QRCodeLabel(QWidget *parent) :
     QLabel(parent)
 {
@@ -24,34 +26,50 @@ QPixmap QRCodeLabel::scaledPixmap() const {
     pm.fill(Qt::white);
     QPainter painter(&pm);
     
-    qrcodegen::QrCode qr = qrcodegen::QrCode::encodeText(address.toUtf8().constData(), qrcodegen::QrCode::Ecc::LOW);
-    const int    s      = qr.getSize()>0?qr.getSize():1;
     const double w      = pm.width();
     const double h      = pm.height();
-    const double aspect = w/h;
-    const double size   = ((aspect>1.0)?h:w);
-    const double scale  = size/(s+2);
-    const double woff   = (w - size) > 0 ? (w - size) / 2 : 0;
-    const double hoff   = (h - size) > 0 ? (h - size) / 2 : 0;
+    const double size   = qMin(w, h);
+    const double woff   = (w - size) / 2;
+    const double hoff   = (h - size) / 2;
+
+    // The modules are already rendered, so resizing is just a nearest-neighbour blit
+    painter.setRenderHint(QPainter::SmoothPixmapTransform, false);
+    painter.drawImage(QRectF(woff, hoff, size, size), qrImage);
     
-    // NOTE: For performance reasons my implementation only draws the foreground parts    
-    painter.setPen(Qt::NoPen);
-    painter.setBrush(QColor(Qt::black));
-    for(int y=0; y<s; y++) {
-        for(int x=0; x<s; x++) {
-            const int color=qr.getModule(x, y);  // 0 for white, 1 for black
-            if(0!=color) {
-                const double rx1=(x+1)*scale + woff, ry1=(y+1)*scale + hoff;
-                QRectF r(rx1, ry1, scale, scale);
-                painter.drawRects(&r,1);
-            }
+    return pm;
+}
+
+QImage QRCodeLabel::moduleImage(const QString& text) {
+    if (auto cached = imageCache.object(text))
+        return *cached;
+
+    qrcodegen::QrCode qr = qrcodegen::QrCode::encodeText(text.toUtf8().constData(), qrcodegen::QrCode::Ecc::LOW);
+    QImage image = moduleImage(qr, 1);
+
+    imageCache.insert(text, new QImage(image));
+    return image;
+}
+
+QImage QRCodeLabel::moduleImage(const qrcodegen::QrCode& qr, int quietZone) {
+    const int s    = qr.getSize();
+    const int side = s + 2 * quietZone;
+
+    QImage image(side, side, QImage::Format_Mono);
+    image.setColor(0, qRgb(255, 255, 255));
+    image.setColor(1, qRgb(0, 0, 0));
+    image.fill(0);
+    for (int y = 0; y < s; y++) {
+        for (int x = 0; x < s; x++) {
+            if (qr.getModule(x, y))
+                image.setPixel(x + quietZone, y + quietZone, 1);
         }
     }
-    
-    return pm;
+
+    return image;
 }
 
 void QRCodeLabel::setAddress(QString addr) {
     address = addr;
+    qrImage = moduleImage(addr);
     QLabel::setPixmap(scaledPixmap());
-}
\ No newline at end of file
+}
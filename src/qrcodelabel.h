@@ -12,11 +12,21 @@ public:
     
     void            setAddress(QString address);
     QPixmap         scaledPixmap() const;
+
+    // The QR code as a 1-bit image with one pixel per module, and a 1 module white border
+    static QImage   moduleImage(const QString& text);
+
+    // As above, with a border of quietZone modules. Nothing is cached, so it can be used from any thread.
+    static QImage   moduleImage(const qrcodegen::QrCode& qr, int quietZone);
 public slots:    
     void resizeEvent(QResizeEvent *);
 
 private:
     QString address;
+    QImage  qrImage;
+
+    // Recently shown codes, so switching between addresses doesn't encode them again
+    static QCache<QString, QImage> imageCache;
 };
 
 
@@ -3,7 +3,11 @@
 #include "addressbook.h"
 #include "settings.h"
 #include "senttxstore.h"
+#include "walletstore.h"
 #include "turnstile.h"
+#include "daemonmonitor.h"
+#include "daemonthrottle.h"
+#include "syncmonitor.h"
 
 using json = nlohmann::json;
 
@@ -17,14 +21,41 @@ RPC::RPC(MainWindow* main) {
     this->ui = main->ui;
 
     this->turnstile = new Turnstile(this, main);
+    this->syncMonitor = new SyncMonitor();
 
     // Setup balances table model
     balancesTableModel = new BalancesTableModel(main->ui->balancesTable);
     main->ui->balancesTable->setModel(balancesTableModel);
 
+    // Setup the model for the "pay from" addresses
+    payFromModel = new AddressBalancesModel(main->ui->inputsCombo);
+    main->ui->inputsCombo->setModel(payFromModel);
+
+    // Setup the models for the receive tab. These are swapped in and out of the receive combo, 
+    // so they must not be owned by it.
+    tAddressesModel       = new AddressBalancesModel(main);
+    saplingAddressesModel = new AddressBalancesModel(main);
+    sproutAddressesModel  = new AddressBalancesModel(main);
+
     // Setup transactions table model
     transactionsTableModel = new TxTableModel(ui->transactionsTable);
     main->ui->transactionsTable->setModel(transactionsTableModel);
+
+    // Older t-transactions are fetched a page at a time as the transactions table is scrolled
+    transactionsTableModel->setTPageFetcher([=] (int from, int count) {
+        if (conn == nullptr) {
+            transactionsTableModel->appendTData(QList<TransactionItem>(), false);
+            return;
+        }
+
+        getTransactions(from, count, [=] (json reply) {
+            auto txdata = processTransactions(reply);
+            transactionsTableModel->appendTData(txdata, txdata.size() >= count);
+        }, [=] (auto, auto) {
+            // Stop paging, the next refresh will try again
+            transactionsTableModel->appendTData(QList<TransactionItem>(), false);
+        });
+    });
     main->ui->transactionsTable->horizontalHeader()->setSectionResizeMode(3, QHeaderView::Stretch);
 
     // Set up timer to refresh Price
@@ -58,12 +89,19 @@ RPC::~RPC() {
 
     delete transactionsTableModel;
     delete balancesTableModel;
+    delete payFromModel;
+    delete tAddressesModel;
+    delete saplingAddressesModel;
+    delete sproutAddressesModel;
     delete turnstile;
 
     delete utxos;
     delete allBalances;
     delete usedAddresses;
     delete zaddresses;
+    delete taddresses;
+
+    delete syncMonitor;
 
     delete conn;
 }
@@ -74,6 +112,67 @@ void RPC::setECommerciumd(QProcess* p) {
     if (ecommerciumd && ui->tabWidget->widget(4) == nullptr) {
         ui->tabWidget->addTab(main->commerciumdtab, "commerciumd");
     }
+
+    if (ecommerciumd && daemonMonitor == nullptr) {
+        setupDaemonMonitor();
+        setupDaemonThrottle();
+    }
+}
+
+// Sync mode of the embedded commerciumd, and how fast it syncs in each mode
+void RPC::setupDaemonThrottle() {
+    if (!DaemonThrottle::isSupported()) {
+        for (auto w : std::initializer_list<QWidget*>{ ui->throttleLabel, ui->throttleSep, ui->throttlePolicy, 
+                                                        ui->throttleSpeedLabel, ui->throttleSpeedSep, ui->throttleSpeed }) {
+            w->setVisible(false);
+        }
+        return;
+    }
+
+    ui->throttlePolicy->setCurrentIndex(Settings::getInstance()->getThrottlePolicy());
+    QObject::connect(ui->throttlePolicy, QOverload<int>::of(&QComboBox::currentIndexChanged), [=] (int index) {
+        Settings::getInstance()->setThrottlePolicy(index);
+    });
+
+    daemonThrottle = new DaemonThrottle(main, ecommerciumd, main->logger);
+    daemonThrottle->setCallback([=] () {
+        auto speed = [=] (DaemonThrottle::Mode m) {
+            double bps = daemonThrottle->blocksPerSec(m);
+            return bps > 0 ? QString::number(bps, 'f', 1) + QObject::tr(" blocks/s") : QObject::tr("not measured");
+        };
+
+        ui->throttleSpeed->setText(QObject::tr("Full speed: ") % speed(DaemonThrottle::FullSpeed) %
+                                   QObject::tr(", background: ") % speed(DaemonThrottle::Background) % 
+                                   (daemonThrottle->getMode() == DaemonThrottle::Background ? QObject::tr(" (now background)") 
+                                                                                           : QObject::tr(" (now full speed)")));
+    });
+}
+
+// Show the embedded commerciumd's resource use on the commerciumd tab
+void RPC::setupDaemonMonitor() {
+    if (!DaemonMonitor::isSupported()) {
+        for (auto label : { ui->rssLabel, ui->rssSep, ui->cpuLabel, ui->cpuSep, ui->ioLabel, ui->ioSep, ui->filesLabel, ui->filesSep }) {
+            label->setVisible(false);
+        }
+        for (auto spark : { ui->rssSpark, ui->cpuSpark, ui->ioSpark }) {
+            spark->setVisible(false);
+        }
+        ui->filesThreads->setVisible(false);
+        return;
+    }
+
+    daemonMonitor = new DaemonMonitor(main, ecommerciumd, main->logger);
+    daemonMonitor->setCallback([=] (const DaemonMonitor::Sample& s) {
+        auto mb = [=] (double bytes) { return QString::number(bytes / (1024 * 1024), 'f', 1); };
+
+        ui->rssSpark->setValues(daemonMonitor->series([] (auto& x) { return (double)x.rssBytes; }),
+                                mb(s.rssBytes) % " MB");
+        ui->cpuSpark->setValues(daemonMonitor->series([] (auto& x) { return x.cpuPercent; }),
+                                QString::number(s.cpuPercent, 'f', 0) % "%");
+        ui->ioSpark->setValues(daemonMonitor->series([] (auto& x) { return x.readPerSec + x.writePerSec; }),
+                               mb(s.readPerSec) % QObject::tr(" MB/s read, ") % mb(s.writePerSec) % QObject::tr(" MB/s written"));
+        ui->filesThreads->setText(QString::number(s.fds) % " / " % QString::number(s.threads));
+    });
 }
 
 void RPC::setConnection(Connection* c) {
@@ -101,6 +200,17 @@ void RPC::getZAddresses(const std::function<void(json)>& cb) {
     conn->doRPCWithDefaultErrorHandling(payload, cb);
 }
 
+void RPC::getTAddresses(const std::function<void(json)>& cb) {
+    json payload = {
+        {"jsonrpc", "1.0"},
+        {"id", "someid"},
+        {"method", "getaddressesbyaccount"},
+        {"params", {""}}
+    };
+
+    conn->doRPCWithDefaultErrorHandling(payload, cb);
+}
+
 void RPC::getTransparentUnspent(const std::function<void(json)>& cb) {
     json payload = {
         {"jsonrpc", "1.0"},
@@ -201,14 +311,17 @@ void RPC::getBalance(const std::function<void(json)>& cb) {
     conn->doRPCWithDefaultErrorHandling(payload, cb);
 }
 
-void RPC::getTransactions(const std::function<void(json)>& cb) {
+// Get a page of t-transactions. "from" counts back from the most recent transaction
+void RPC::getTransactions(int from, int count, const std::function<void(json)>& cb,
+                          const std::function<void(QNetworkReply*, const json&)>& ne) {
     json payload = {
         {"jsonrpc", "1.0"},
         {"id", "someid"},
-        {"method", "listtransactions"}
+        {"method", "listtransactions"},
+        {"params", {"*", count, from}}
     };
 
-    conn->doRPCWithDefaultErrorHandling(payload, cb);
+    conn->doRPC(payload, cb, ne);
 }
 
 void RPC::sendZTransaction(json params, const std::function<void(json)>& cb) {
@@ -373,7 +486,7 @@ void RPC::noConnection() {
     ui->balTotal->setToolTip("");
 
     // Clear send tab from address
-    ui->inputsCombo->clear();
+    payFromModel->setBalances(QMap<QString, double>());
 }
 
 // Refresh received z txs by calling z_listreceivedbyaddress/gettransaction
@@ -512,24 +625,38 @@ void RPC::getInfoThenRefresh(bool force) {
         prevCallSucceeded = true;
         // Testnet?
         if (!reply["testnet"].is_null()) {
-            Settings::getInstance()->setTestnet(reply["testnet"].get<json::boolean_t>());
+            bool testnet = reply["testnet"].get<json::boolean_t>();
+            if (testnet != Settings::getInstance()->isTestnet()) {
+                Settings::getInstance()->setTestnet(testnet);
+                WalletStore::getInstance()->switchNetwork();
+            }
         };
 
         // Connected, so display checkmark.
         QIcon i(":/icons/res/connected.gif");
         main->statusIcon->setPixmap(i.pixmap(16, 16));
 
+        auto refreshWallet = [=] () {
+            refreshBalances();        
+            refreshAddresses(); // This calls refreshZSentTransactions() and refreshReceivedZTrans()
+            refreshTransactions();
+        };
+
         static int    lastBlock = 0;
+        static int    lastRefreshBlock = 0;
         int curBlock  = reply["blocks"].get<json::number_integer_t>();
 
-        if ( force || (curBlock != lastBlock) ) {
-            // Something changed, so refresh everything.
-            lastBlock = curBlock;
+        // While syncing, blocks change on almost every call, and the wallet calls slow commerciumd
+        // down while it validates them. So only refresh every few thousand blocks until it's synced.
+        int  every    = Settings::getInstance()->snapshot()->syncRefreshBlocks;
+        bool deferred = Settings::getInstance()->isSyncing() && every > 0 && curBlock - lastRefreshBlock < every;
 
-            refreshBalances();        
-            refreshAddresses(); // This calls refreshZSentTransactions() and refreshReceivedZTrans()
-            refreshTransactions();
+        if ( force || (curBlock != lastBlock && !deferred) ) {
+            // Something changed, so refresh everything.
+            lastRefreshBlock = curBlock;
+            refreshWallet();
         }
+        lastBlock = curBlock;
 
         int connections = reply["connections"].get<json::number_integer_t>();
         Settings::getInstance()->setPeers(connections);
@@ -568,6 +695,10 @@ void RPC::getInfoThenRefresh(bool force) {
             bool isSyncing   = progress < 0.9999; // 99.99%
             int  blockNumber = reply["blocks"].get<json::number_unsigned_t>();
 
+            // Refreshes were held back during the sync, so catch up now that it's done
+            if (Settings::getInstance()->isSyncing() && !isSyncing)
+                refreshWallet();
+
             int estimatedheight = 0;
             if (reply.find("estimatedheight") != reply.end()) {
                 estimatedheight = reply["estimatedheight"].get<json::number_unsigned_t>();
@@ -576,6 +707,9 @@ void RPC::getInfoThenRefresh(bool force) {
             Settings::getInstance()->setSyncing(isSyncing);
             Settings::getInstance()->setBlockNumber(blockNumber);
 
+            syncMonitor->addSample(blockNumber, progress);
+            auto syncRate = syncMonitor->snapshot();
+
             // Update commerciumd tab if it exists
             if (ecommerciumd) {
                 if (isSyncing) {
@@ -589,10 +723,16 @@ void RPC::getInfoThenRefresh(bool force) {
                     txt = txt %  " ( " % QString::number(progress * 100, 'f', 0) % "% )";
                     ui->blockheight->setText(txt);
                     ui->heightLabel->setText(QObject::tr("Downloading blocks"));
+                    ui->syncEta->setText(SyncMonitor::formatEta(syncRate.etaSecs));
                 } else {
                     ui->blockheight->setText(QString::number(blockNumber));
                     ui->heightLabel->setText(QObject::tr("Block height"));
+                    ui->syncEta->setText(QObject::tr("Synced"));
                 }
+
+                ui->syncSpark->setValues(syncMonitor->blocksPerSecSeries(),
+                                         QString::number(syncRate.recentBlocksPerSec, 'f', 1) % QObject::tr(" blocks/s, ") %
+                                         QString::number(syncRate.blocksPerSec, 'f', 1) % QObject::tr(" blocks/s over 30 min"));
             }
 
             // Update the status bar
@@ -602,7 +742,8 @@ void RPC::getInfoThenRefresh(bool force) {
                 (Settings::getInstance()->isTestnet() ? QObject::tr("testnet:") : "") %
                 QString::number(blockNumber) %
                 (isSyncing ? ("/" % QString::number(progress*100, 'f', 0) % "%") : QString()) %
-                ")";
+                ")" %
+                (isSyncing && syncRate.etaSecs >= 0 ? QObject::tr(", ") + SyncMonitor::formatEta(syncRate.etaSecs) + QObject::tr(" left") : QString());
             main->statusLabel->setText(statusText);   
 
             auto cmmPrice = Settings::getUSDFormat(1);
@@ -654,9 +795,78 @@ void RPC::refreshAddresses() {
         // Refresh the sent and received txs from all these z-addresses
         refreshSentZTrans();
         refreshReceivedZTrans(*zaddresses);
+
+        updateReceiveModels();
+    });
+
+    getTAddresses([=] (json reply) {
+        auto newTAddresses = new QList<QString>();
+        for (auto& it : reply.get<json::array_t>()) {   
+            newTAddresses->push_back(QString::fromStdString(it.get<json::string_t>()));
+        }
+
+        delete taddresses;
+        taddresses = newTAddresses;
+
+        updateReceiveModels();
     });
 }
 
+/**
+ * Update the receive tab's address lists with all the wallet's addresses and their balances. 
+ * This is done once per refresh, so that switching between address types in the receive tab
+ * only has to swap the model.
+ */
+void RPC::updateReceiveModels() {
+    QMap<QString, double> tAddrs, saplingAddrs, sproutAddrs;
+
+    auto fnBalance = [=] (const QString& addr) {
+        return allBalances == nullptr ? 0.0 : allBalances->value(addr);
+    };
+
+    if (taddresses != nullptr) {
+        for (const auto& addr : *taddresses) {
+            tAddrs.insert(addr, fnBalance(addr));
+        }
+    }
+
+    // Funded t-addresses that are not in the default account
+    if (allBalances != nullptr) {
+        for (auto it = allBalances->constBegin(); it != allBalances->constEnd(); it++) {
+            if (!it.key().startsWith("z"))
+                tAddrs.insert(it.key(), it.value());
+        }
+    }
+
+    if (zaddresses != nullptr) {
+        for (const auto& addr : *zaddresses) {
+            if (Settings::getInstance()->isSaplingAddress(addr))
+                saplingAddrs.insert(addr, fnBalance(addr));
+            else
+                sproutAddrs.insert(addr, fnBalance(addr));
+        }
+    }
+
+    tAddressesModel->setBalances(tAddrs);
+    saplingAddressesModel->setBalances(saplingAddrs);
+    sproutAddressesModel->setBalances(sproutAddrs);
+}
+
+// Add a newly created address, so it shows up right away instead of at the next refresh
+void RPC::addNewAddress(const QString& addr) {
+    if (addr.startsWith("z")) {
+        if (zaddresses == nullptr)
+            zaddresses = new QList<QString>();
+        zaddresses->push_back(addr);
+    } else {
+        if (taddresses == nullptr)
+            taddresses = new QList<QString>();
+        taddresses->push_back(addr);
+    }
+
+    updateReceiveModels();
+}
+
 // Function to create the data model and update the views, used below.
 void RPC::updateUI(bool anyUnconfirmed) {
     // See if the turnstile migration has any steps that need to be done.
@@ -667,21 +877,20 @@ void RPC::updateUI(bool anyUnconfirmed) {
     // Update balances model data, which will update the table too
     balancesTableModel->setNewData(allBalances, utxos);
 
-    // Add all the addresses into the inputs combo box
-    auto lastFromAddr = ui->inputsCombo->currentText();
-
-    ui->inputsCombo->clear();
-    auto i = allBalances->constBegin();
-    while (i != allBalances->constEnd()) {
-         ui->inputsCombo->addItem(i.key(), i.value());
-        if (i.key() == lastFromAddr) ui->inputsCombo->setCurrentText(i.key());
-
-        ++i;
-    }
+    // Update the addresses in the inputs combo box. Only the rows that changed are updated,
+    // so the selected address stays selected, and an open popup stays open.
+    bool wasEmpty = payFromModel->rowCount(QModelIndex()) == 0;
+    payFromModel->setBalances(*allBalances);
 
-    if (lastFromAddr.isEmpty()) {
+    if (wasEmpty) {
         main->setDefaultPayFrom();
     }
+
+    // Update the balances in the receive tab
+    updateReceiveModels();
+
+    // The balance of the selected address might have changed
+    main->updatePayFromBalance();
 };
 
 // Function to process reply of the listunspent and z_listunspent API calls, used below.
@@ -742,41 +951,89 @@ void RPC::refreshBalances() {
     });
 }
 
-void RPC::refreshTransactions() {    
-    if  (conn == nullptr) 
-        return noConnection();
+// Function to process reply of the listtransactions API call, used below.
+QList<TransactionItem> RPC::processTransactions(const json& reply) {
+    QList<TransactionItem> txdata;
 
-    getTransactions([=] (json reply) {
-        QList<TransactionItem> txdata;
+    if (!reply.is_array())
+        return txdata;
 
-        for (auto& it : reply.get<json::array_t>()) {  
-            double fee = 0;
-            if (!it["fee"].is_null()) {
-                fee = it["fee"].get<json::number_float_t>();
-            }
+    for (auto& it : reply.get<json::array_t>()) {  
+        double fee = 0;
+        if (!it["fee"].is_null()) {
+            fee = it["fee"].get<json::number_float_t>();
+        }
 
-            QString address = (it["address"].is_null() ? "" : QString::fromStdString(it["address"]));
+        QString address = (it["address"].is_null() ? "" : QString::fromStdString(it["address"]));
 
-            TransactionItem tx{
-                QString::fromStdString(it["category"]),
-                (qint64)it["time"].get<json::number_unsigned_t>(),
-                address,
-                QString::fromStdString(it["txid"]),
-                it["amount"].get<json::number_float_t>() + fee,
-                (unsigned long)it["confirmations"].get<json::number_unsigned_t>(),
-                "", "" };
+        TransactionItem tx{
+            QString::fromStdString(it["category"]),
+            (qint64)it["time"].get<json::number_unsigned_t>(),
+            address,
+            QString::fromStdString(it["txid"]),
+            it["amount"].get<json::number_float_t>() + fee,
+            (unsigned long)it["confirmations"].get<json::number_unsigned_t>(),
+            "", "" };
 
-            txdata.push_back(tx);
-            if (!address.isEmpty())
-                usedAddresses->insert(address, true);
+        txdata.push_back(tx);
+    }
+
+    return txdata;
+}
+
+/**
+ * The receive tab warns before an address is reused, so it needs every t-address that has ever
+ * received funds, not just the ones in the pages of the transactions table that have been loaded.
+ */
+void RPC::refreshUsedTAddresses() {
+    json payload = {
+        {"jsonrpc", "1.0"},
+        {"id", "someid"},
+        {"method", "listreceivedbyaddress"},
+        {"params", {0, true}}           // 0 conf, and include addresses that haven't received yet
+    };
+
+    conn->doRPCIgnoreError(payload, [=] (const json& reply) {
+        if (!reply.is_array())
+            return;
+
+        for (auto& it : reply.get<json::array_t>()) {
+            if (it["txids"].is_array() && !it["txids"].empty())
+                usedAddresses->insert(QString::fromStdString(it["address"].get<json::string_t>()), true);
         }
+    });
+}
+
+void RPC::refreshTransactions() {    
+    if  (conn == nullptr) 
+        return noConnection();
+
+    // Only load the most recent page. The model merges it in front of any older pages that were loaded
+    // as the table was scrolled or searched, so those aren't fetched again on every refresh.
+    int count = TxTableModel::pageSize;
+
+    getTransactions(0, count, [=] (json reply) {
+        auto txdata = processTransactions(reply);
 
         // Update model data, which updates the table view
-        transactionsTableModel->addTData(txdata);        
+        transactionsTableModel->addTData(txdata, txdata.size() >= count);        
+    }, [=] (QNetworkReply* reply, const json& parsed) {
+        if (!parsed.is_discarded() && !parsed["error"]["message"].is_null()) {
+            conn->showTxError(QString::fromStdString(parsed["error"]["message"]));    
+        } else {
+            conn->showTxError(reply->errorString());
+        }
     });
+
+    refreshUsedTAddresses();
 }
 
-// Read sent Z transactions from the file.
+/**
+ * Read sent Z transactions from the file. The block each tx was mined in is remembered, so 
+ * confirmations are worked out from the current tip. Only txs that haven't been seen in a block
+ * yet are looked up with gettransaction, and recent blocks are checked with getblockhash to catch
+ * reorgs, so there are no RPCs at all for older sent txs.
+ */
 void RPC::refreshSentZTrans() {
     if  (conn == nullptr) 
         return noConnection();
@@ -790,43 +1047,138 @@ void RPC::refreshSentZTrans() {
         return;
     }
 
-    QList<QString> txids;
+    int  curBlock = Settings::getInstance()->getBlockNumber();
+    auto mined    = SentTxStore::getMinedBlocks();
+
+    QList<QString> unmined;
+    QList<int>     recentHeights;
+    for (const auto& sentTx: sentZTxs) {
+        auto it = mined.constFind(sentTx.txid);
+        if (it == mined.constEnd()) {
+            unmined.push_back(sentTx.txid);
+        } else if (curBlock - it->height < reorgCheckDepth && !recentHeights.contains(it->height)) {
+            recentHeights.push_back(it->height);
+        }
+    }
+
+    auto fnShowSentTxs = [=] () {
+        auto newSentZTxs = sentZTxs;
+        auto newMined    = SentTxStore::getMinedBlocks();
+        int  tip         = Settings::getInstance()->getBlockNumber();
+
+        for (TransactionItem& sentTx: newSentZTxs) {
+            auto it = newMined.constFind(sentTx.txid);
+            if (it != newMined.constEnd() && tip >= it->height)
+                sentTx.confirmations = tip - it->height + 1;
+        }
+
+        transactionsTableModel->addZSentData(newSentZTxs);
+    };
 
-    for (auto sentTx: sentZTxs) {
-        txids.push_back(sentTx.txid);
+    // Look up the txids to find the block they were mined in
+    auto fnLookupTxs = [=] (QList<QString> txids) {
+        if (txids.isEmpty()) {
+            fnShowSentTxs();
+            return;
+        }
+
+        conn->doBatchRPC<QString>(txids,
+            [=] (QString txid) {
+                json payload = {
+                    {"jsonrpc", "1.0"},
+                    {"id", "senttxid"},
+                    {"method", "gettransaction"},
+                    {"params", {txid.toStdString()}} 
+                };
+
+                return payload;
+            },          
+            [=] (QMap<QString, json>* txidList) {
+                // The tip we know about can be older than the reply, so the height is taken from the
+                // block itself rather than worked out from the confirmations
+                QMap<QString, QString> needHeight;     // txid -> blockhash
+                for (auto it = txidList->begin(); it != txidList->end(); it++) {
+                    auto j = it.value();
+                    if (j.is_null() || j["confirmations"].is_null())
+                        continue;
+
+                    auto confirmations = j["confirmations"].get<json::number_integer_t>();
+                    if (confirmations > 0 && !j["blockhash"].is_null()) {
+                        auto hash = QString::fromStdString(j["blockhash"].get<json::string_t>());
+                        if (j["blockheight"].is_number())
+                            SentTxStore::setMinedBlock(it.key(), MinedBlock{ j["blockheight"].get<int>(), hash });
+                        else
+                            needHeight.insert(it.key(), hash);
+                    } else {
+                        SentTxStore::clearMinedBlock(it.key());
+                    }
+                }
+                delete txidList;
+
+                if (needHeight.isEmpty()) {
+                    fnShowSentTxs();
+                    return;
+                }
+
+                auto hashes = needHeight.values().toSet().toList();
+                conn->doBatchRPC<QString>(hashes,
+                    [=] (QString hash) {
+                        json payload = {
+                            {"jsonrpc", "1.0"},
+                            {"id", "someid"},
+                            {"method", "getblockheader"},
+                            {"params", {hash.toStdString(), true}} 
+                        };
+
+                        return payload;
+                    },
+                    [=] (QMap<QString, json>* headers) {
+                        for (auto it = needHeight.constBegin(); it != needHeight.constEnd(); it++) {
+                            auto header = headers->value(it.value());
+                            if (header.is_object() && header["height"].is_number())
+                                SentTxStore::setMinedBlock(it.key(), MinedBlock{ header["height"].get<int>(), it.value() });
+                        }
+
+                        fnShowSentTxs();
+                        delete headers;
+                    }
+                );
+            }
+        );
+    };
+
+    if (recentHeights.isEmpty()) {
+        fnLookupTxs(unmined);
+        return;
     }
 
-    // Look up all the txids to get the confirmation count for them. 
-    conn->doBatchRPC<QString>(txids,
-        [=] (QString txid) {
+    // Check that the recent blocks are still in the main chain, and look up the txs again if not
+    conn->doBatchRPC<int>(recentHeights,
+        [=] (int height) {
             json payload = {
                 {"jsonrpc", "1.0"},
-                {"id", "senttxid"},
-                {"method", "gettransaction"},
-                {"params", {txid.toStdString()}} 
+                {"id", "someid"},
+                {"method", "getblockhash"},
+                {"params", {height}} 
             };
 
             return payload;
-        },          
-        [=] (QMap<QString, json>* txidList) {
-            auto newSentZTxs = sentZTxs;
-            // Update the original sent list with the confirmation count
-            // TODO: This whole thing is kinda inefficient. We should probably just update the file
-            // with the confirmed block number, so we don't have to keep calling gettransaction for the
-            // sent items.
-            for (TransactionItem& sentTx: newSentZTxs) {
-                auto j = txidList->value(sentTx.txid);
-                if (j.is_null())
+        },
+        [=] (QMap<int, json>* blockHashes) {
+            auto txids = unmined;
+            for (auto it = mined.constBegin(); it != mined.constEnd(); it++) {
+                if (!blockHashes->contains(it->height))
                     continue;
-                auto error = j["confirmations"].is_null();
-                if (!error)
-                    sentTx.confirmations = j["confirmations"].get<json::number_unsigned_t>();
+
+                auto hash = blockHashes->value(it->height);
+                if (!hash.is_string() || QString::fromStdString(hash.get<json::string_t>()) != it->hash)
+                    txids.push_back(it.key());
             }
-            
-            transactionsTableModel->addZSentData(newSentZTxs);
-            delete txidList;
+
+            fnLookupTxs(txids);
+            delete blockHashes;
         }
-     );
+    );
 }
 
 void RPC::addNewTxToWatch(Tx tx, const QString& newOpid) {    
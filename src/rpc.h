@@ -4,6 +4,7 @@
 #include "precompiled.h"
 
 #include "balancestablemodel.h"
+#include "addressbalancesmodel.h"
 #include "txtablemodel.h"
 #include "ui_mainwindow.h"
 #include "mainwindow.h"
@@ -12,6 +13,9 @@
 using json = nlohmann::json;
 
 class Turnstile;
+class DaemonMonitor;
+class DaemonThrottle;
+class SyncMonitor;
 
 struct TransactionItem {
     QString         type;
@@ -47,10 +51,18 @@ public:
     void addNewTxToWatch(Tx tx, const QString& newOpid); 
 
     const TxTableModel*               getTransactionsModel() { return transactionsTableModel; }
+    const SyncMonitor*                getSyncMonitor()       { return syncMonitor; }
     const QList<QString>*             getAllZAddresses()     { return zaddresses; }
     const QList<UnspentOutput>*       getUTXOs()             { return utxos; }
     const QMap<QString, double>*      getAllBalances()       { return allBalances; }
     const QMap<QString, bool>*        getUsedAddresses()     { return usedAddresses; }
+    AddressBalancesModel*             getPayFromModel()      { return payFromModel; }
+
+    // All the addresses in the wallet, including the ones without a balance, for the receive tab
+    AddressBalancesModel*             getTAddressesModel()       { return tAddressesModel; }
+    AddressBalancesModel*             getSaplingAddressesModel() { return saplingAddressesModel; }
+    AddressBalancesModel*             getSproutAddressesModel()  { return sproutAddressesModel; }
+    void                              addNewAddress(const QString& addr);
 
     void newZaddr(bool sapling, const std::function<void(json)>& cb);
     void newTaddr(const std::function<void(json)>& cb);
@@ -74,33 +86,49 @@ private:
     void refreshBalances();
 
     void refreshTransactions();    
+    void refreshUsedTAddresses();
     void refreshSentZTrans();
     void refreshReceivedZTrans(QList<QString> zaddresses);
 
     bool processUnspent     (const json& reply);
+    void updateReceiveModels();
+    QList<TransactionItem> processTransactions(const json& reply);
     void updateUI           (bool anyUnconfirmed);
 
     void getInfoThenRefresh(bool force);
 
+    void setupDaemonMonitor();
+    void setupDaemonThrottle();
+
     void getBalance(const std::function<void(json)>& cb);
 
     void getTransparentUnspent  (const std::function<void(json)>& cb);
     void getZUnspent            (const std::function<void(json)>& cb);
-    void getTransactions        (const std::function<void(json)>& cb);
+    void getTransactions        (int from, int count, const std::function<void(json)>& cb, 
+                                 const std::function<void(QNetworkReply*, const json&)>& ne);
     void getZAddresses          (const std::function<void(json)>& cb);
+    void getTAddresses          (const std::function<void(json)>& cb);
 
     Connection*                 conn                        = nullptr;
     QProcess*                   ecommerciumd                     = nullptr;
+    DaemonMonitor*              daemonMonitor               = nullptr;
+    DaemonThrottle*             daemonThrottle              = nullptr;
+    SyncMonitor*                syncMonitor                 = nullptr;
 
     QList<UnspentOutput>*       utxos                       = nullptr;
     QMap<QString, double>*      allBalances                 = nullptr;
     QMap<QString, bool>*        usedAddresses               = nullptr;
     QList<QString>*             zaddresses                  = nullptr;
+    QList<QString>*             taddresses                  = nullptr;
     
     QMap<QString, Tx>           watchingOps;
 
     TxTableModel*               transactionsTableModel      = nullptr;
     BalancesTableModel*         balancesTableModel          = nullptr;
+    AddressBalancesModel*       payFromModel                = nullptr;
+    AddressBalancesModel*       tAddressesModel             = nullptr;
+    AddressBalancesModel*       saplingAddressesModel       = nullptr;
+    AddressBalancesModel*       sproutAddressesModel        = nullptr;
 
     QTimer*                     timer;
     QTimer*                     txTimer;
@@ -112,6 +140,9 @@ private:
 
     // Current balance in the UI. If this number updates, then refresh the UI
     QString                     currentBalance;
+
+    // Sent txs mined more than this many blocks ago are not checked for reorgs
+    static const int            reorgCheckDepth = 100;
 };
 
 #endif // RPCCLIENT_H
@@ -0,0 +1,216 @@
+#!/bin/bash
+# Times how long a second commerciumd takes to sync a regtest chain from a first one, to compare
+# commercium.conf settings:
+#
+#   ZCASH_DIR=<dir> src/scripts/regtestsync.sh tuning
+#   ZCASH_DIR=<dir> src/scripts/regtestsync.sh refresh
+#
+# tuning    Syncs once with the default options, and once with the options DaemonTuning would
+#           write for this computer (dbcache, par, rpcthreads, rpcworkqueue).
+# refresh   Syncs twice while making the RPCs the wallet makes, every POLL seconds (1 by default).
+#           Once refreshing the whole wallet whenever the block changes, as it did before, and
+#           once only making the status calls and refreshing every SYNC_REFRESH_BLOCKS blocks
+#           (10000 by default, like options/syncrefreshblocks). The syncing node is given ADDRESSES
+#           t and z addresses (20 by default), so the refreshes have something to list.
+#
+# BLOCKS sets the length of the chain, 2000 by default. The chain is generated once and kept in
+# WORK_DIR (/tmp/cmm-regtest-sync by default), so later runs only time the syncs. Regtest blocks are
+# nearly empty, so the times are only useful compared with each other. They include starting
+# commerciumd, which takes the same time either way.
+
+if [ -z $ZCASH_DIR ]; then
+    echo "ZCASH_DIR is not set. Please set it to the base directory of a Commercium project with built Commercium binaries."
+    exit 1;
+fi
+
+COMMERCIUMD=$ZCASH_DIR/artifacts/commerciumd
+COMMERCIUM_CLI=$ZCASH_DIR/artifacts/commercium-cli
+
+if [ ! -f $COMMERCIUMD ] || [ ! -f $COMMERCIUM_CLI ]; then
+    echo "Couldn't find commerciumd and commercium-cli in $ZCASH_DIR/artifacts/. Please build commerciumd."
+    exit 1;
+fi
+
+MODE=$1
+if [ "$MODE" != "tuning" ] && [ "$MODE" != "refresh" ]; then
+    echo "Usage: $0 tuning|refresh"
+    exit 1;
+fi
+
+BLOCKS=${BLOCKS:-2000}
+WORK_DIR=${WORK_DIR:-/tmp/cmm-regtest-sync}
+POLL=${POLL:-1}
+SYNC_REFRESH_BLOCKS=${SYNC_REFRESH_BLOCKS:-10000}
+ADDRESSES=${ADDRESSES:-20}
+
+SOURCE_PORT=18544
+SOURCE_RPCPORT=18545
+SYNC_PORT=18554
+SYNC_RPCPORT=18555
+
+RPC_ARGS="-rpcuser=regtest -rpcpassword=regtest"
+
+# cli <datadir> <rpcport> <command> [args...]
+cli() {
+    local datadir=$1 rpcport=$2
+    shift 2
+    $COMMERCIUM_CLI -regtest -datadir=$datadir -rpcport=$rpcport $RPC_ARGS "$@"
+}
+
+# Wait until the node answers RPCs
+waitForRpc() {
+    for i in $(seq 1 120); do
+        if cli $1 $2 getblockcount > /dev/null 2>&1; then
+            return 0
+        fi
+        sleep 1
+    done
+
+    echo "commerciumd in $1 didn't start"
+    exit 1
+}
+
+stopNode() {
+    cli $1 $2 stop > /dev/null 2>&1
+    while cli $1 $2 getblockcount > /dev/null 2>&1; do
+        sleep 1
+    done
+
+    # It stops answering RPCs a little before it has closed its databases
+    sleep 2
+}
+
+# The same proposal as DaemonTuning::propose
+tunedOptions() {
+    local cores ramMB
+    cores=$(getconf _NPROCESSORS_ONLN)
+    if [ -f /proc/meminfo ]; then
+        ramMB=$(( $(awk '/MemTotal/ { print $2 }' /proc/meminfo) / 1024 ))
+    else
+        ramMB=$(( $(sysctl -n hw.memsize) / 1024 / 1024 ))
+    fi
+
+    local dbcache=$(( ramMB / 4 ))
+    [ $dbcache -lt 100 ]  && dbcache=100
+    [ $dbcache -gt 4096 ] && dbcache=4096
+
+    local par=$(( cores - 1 ))
+    [ $par -lt 1 ]  && par=1
+    [ $par -gt 16 ] && par=16
+
+    local rpcthreads=$(( cores / 2 ))
+    [ $rpcthreads -lt 4 ] && rpcthreads=4
+    [ $rpcthreads -gt 8 ] && rpcthreads=8
+
+    echo "-dbcache=$dbcache -par=$par -rpcthreads=$rpcthreads -rpcworkqueue=$(( rpcthreads * 8 ))"
+}
+
+# Generate the chain to sync from, unless it's already there
+SOURCE_DIR=$WORK_DIR/source
+echo -n "Source chain..........."
+mkdir -p $SOURCE_DIR
+$COMMERCIUMD -regtest -datadir=$SOURCE_DIR -port=$SOURCE_PORT -rpcport=$SOURCE_RPCPORT $RPC_ARGS -listen -daemon > /dev/null
+waitForRpc $SOURCE_DIR $SOURCE_RPCPORT
+
+HEIGHT=$(cli $SOURCE_DIR $SOURCE_RPCPORT getblockcount)
+while [ $HEIGHT -lt $BLOCKS ]; do
+    COUNT=$(( BLOCKS - HEIGHT ))
+    [ $COUNT -gt 100 ] && COUNT=100
+    cli $SOURCE_DIR $SOURCE_RPCPORT generate $COUNT > /dev/null || exit 1
+    HEIGHT=$(cli $SOURCE_DIR $SOURCE_RPCPORT getblockcount)
+done
+echo "[OK] $HEIGHT blocks"
+
+# The calls RPC::refreshBalances, refreshAddresses and refreshTransactions make
+refreshWallet() {
+    local dir=$1 rpcport=$2
+
+    cli $dir $rpcport z_gettotalbalance 0 > /dev/null 2>&1
+    cli $dir $rpcport listunspent 0 > /dev/null 2>&1
+    cli $dir $rpcport z_listunspent 0 > /dev/null 2>&1
+    cli $dir $rpcport getaddressesbyaccount "" > /dev/null 2>&1
+    for zaddr in $(cli $dir $rpcport z_listaddresses 2> /dev/null | tr -d '[]", '); do
+        cli $dir $rpcport z_listreceivedbyaddress $zaddr 0 > /dev/null 2>&1
+    done
+    cli $dir $rpcport listtransactions "" 100 0 > /dev/null 2>&1
+    cli $dir $rpcport listreceivedbyaddress 0 true > /dev/null 2>&1
+}
+
+# walletLoad <datadir> <rpcport> gated|ungated. Runs until it's killed.
+walletLoad() {
+    local dir=$1 rpcport=$2 gating=$3
+    local lastBlock=-1 lastRefreshBlock=0
+
+    while true; do
+        local block=$(cli $dir $rpcport getblockcount 2> /dev/null)
+        cli $dir $rpcport getinfo > /dev/null 2>&1
+        cli $dir $rpcport getnetworksolps > /dev/null 2>&1
+        cli $dir $rpcport getblockchaininfo > /dev/null 2>&1
+
+        if [ -n "$block" ] && [ "$block" != "$lastBlock" ]; then
+            if [ "$gating" == "ungated" ] || [ $(( block - lastRefreshBlock )) -ge $SYNC_REFRESH_BLOCKS ]; then
+                refreshWallet $dir $rpcport
+                lastRefreshBlock=$block
+            fi
+            lastBlock=$block
+        fi
+
+        sleep $POLL
+    done
+}
+
+# timeSync <label> <extra commerciumd options> [gated|ungated]
+timeSync() {
+    local label=$1 options=$2 load=$3
+    local dir=$WORK_DIR/sync
+
+    rm -rf $dir
+    mkdir -p $dir
+
+    local start=$(date +%s.%N)
+    $COMMERCIUMD -regtest -datadir=$dir -port=$SYNC_PORT -rpcport=$SYNC_RPCPORT $RPC_ARGS \
+        -connect=127.0.0.1:$SOURCE_PORT -listen=0 $options -daemon > /dev/null
+    waitForRpc $dir $SYNC_RPCPORT
+
+    local loadPid=""
+    if [ -n "$load" ]; then
+        for i in $(seq 1 $ADDRESSES); do
+            cli $dir $SYNC_RPCPORT getnewaddress > /dev/null 2>&1
+            cli $dir $SYNC_RPCPORT z_getnewaddress > /dev/null 2>&1
+        done
+
+        walletLoad $dir $SYNC_RPCPORT $load &
+        loadPid=$!
+    fi
+
+    while [ "$(cli $dir $SYNC_RPCPORT getblockcount 2> /dev/null)" != "$HEIGHT" ]; do
+        sleep 0.2
+    done
+    local end=$(date +%s.%N)
+
+    if [ -n "$loadPid" ]; then
+        kill $loadPid
+        wait $loadPid 2> /dev/null
+    fi
+
+    stopNode $dir $SYNC_RPCPORT
+    printf "%-24s %8.1f s  %8.0f blocks/s\n" "$label" $(echo "$end - $start" | bc) $(echo "$HEIGHT / ($end - $start)" | bc -l)
+}
+
+echo ""
+echo "[Syncing $HEIGHT blocks]"
+
+if [ "$MODE" == "tuning" ]; then
+    TUNED=$(tunedOptions)
+    echo "Tuned options: $TUNED"
+    timeSync "default" ""
+    timeSync "tuned" "$TUNED"
+fi
+
+if [ "$MODE" == "refresh" ]; then
+    echo "Wallet RPCs every $POLL s, $ADDRESSES t and z addresses"
+    timeSync "refresh on every block" "" ungated
+    timeSync "refresh gated" "" gated
+fi
+
+stopNode $SOURCE_DIR $SOURCE_RPCPORT
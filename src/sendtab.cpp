@@ -1,6 +1,7 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
 #include "addressbook.h"
+#include "addressvalidator.h"
 #include "ui_confirm.h"
 #include "ui_memodialog.h"
 #include "settings.h"
@@ -59,6 +60,12 @@ void MainWindow::setupSendTab() {
     // Fee amount changed
     // Disable custom fees if settings say no
     ui->minerFeeAmt->setReadOnly(!Settings::getInstance()->getAllowCustomFees());
+    QObject::connect(Settings::getInstance(), &Settings::optionsChanged, this, [=] () {
+        bool customFees = Settings::getInstance()->getAllowCustomFees();
+        ui->minerFeeAmt->setReadOnly(!customFees);
+        if (!customFees)
+            ui->minerFeeAmt->setText(Settings::getDecimalString(Settings::getMinerFee()));
+    });
     QObject::connect(ui->minerFeeAmt, &QLineEdit::textChanged, [=](auto txt) {
         ui->lblMinerFeeUSD->setText(Settings::getUSDFormat(txt.toDouble()));
     });
@@ -140,6 +147,10 @@ void MainWindow::inputComboTextChanged(int index) {
     ui->sendAddressBalanceUSD->setText(Settings::getUSDFormat(bal));
 }
 
+void MainWindow::updatePayFromBalance() {
+    inputComboTextChanged(ui->inputsCombo->currentIndex());
+}
+
     
 void MainWindow::addAddressSection() {
     int itemNumber = ui->sendToWidgets->children().size() - 1;
@@ -235,7 +246,7 @@ void MainWindow::addAddressSection() {
 }
 
 void MainWindow::addressChanged(int itemNumber, const QString& text) {   
-    auto addr = AddressBook::addressFromAddressLabel(text);
+    auto addr = AddressValidator::normalize(AddressBook::addressFromAddressLabel(text));
     setMemoEnabled(itemNumber, addr.startsWith("z"));
 }
 
@@ -258,7 +269,7 @@ void MainWindow::setMemoEnabled(int number, bool enabled) {
 void MainWindow::memoButtonClicked(int number, bool includeReplyTo) {
     // Memos can only be used with zAddrs. So check that first
     auto addr = ui->sendToWidgets->findChild<QLineEdit*>(QString("Address") + QString::number(number));
-    if (!AddressBook::addressFromAddressLabel(addr->text()).startsWith("z")) {
+    if (!AddressValidator::normalize(AddressBook::addressFromAddressLabel(addr->text())).startsWith("z")) {
         QMessageBox msg(QMessageBox::Critical, tr("Memos can only be used with z-addresses"),
         tr("The memo field can only be used with a z-address.\n") + addr->text() + tr("\ndoesn't look like a z-address"),
         QMessageBox::Ok, this);
@@ -407,7 +418,7 @@ Tx MainWindow::createTxFromSendPage() {
     for (int i=0; i < totalItems; i++) {
         QString addr = ui->sendToWidgets->findChild<QLineEdit*>(QString("Address") % QString::number(i+1))->text().trimmed();
         // Remove label if it exists
-        addr = AddressBook::addressFromAddressLabel(addr);
+        addr = AddressValidator::normalize(AddressBook::addressFromAddressLabel(addr));
         
         // If address is sprout, then we can't send change to sapling, because of turnstile.
         sendChangeToSapling = sendChangeToSapling && !Settings::getInstance()->isSproutAddress(addr);
@@ -1,7 +1,17 @@
 #include "senttxstore.h"
 #include "settings.h"
+#include "walletstore.h"
 
-/// Get the location of the app data file to be written. 
+QList<TransactionItem>* SentTxStore::items          = nullptr;
+QHash<QString, int>     SentTxStore::rowByTxid;
+QHash<QString, MinedBlock> SentTxStore::minedByTxid;
+bool                    SentTxStore::loadedTestnet  = false;
+
+// Namespaces in the wallet store
+static const QString sentNamespace  = QStringLiteral("senttxs");
+static const QString minedNamespace = QStringLiteral("senttxblocks");
+
+/// Get the location of the old JSON file, which is only read to migrate it to the wallet store.
 QString SentTxStore::writeableFile() {
     auto filename = QStringLiteral("senttxstore.dat");
 
@@ -16,38 +26,27 @@ QString SentTxStore::writeableFile() {
     }
 }
 
-// delete the sent history. 
+// delete the sent history.
 void SentTxStore::deleteHistory() {
-    QFile data(writeableFile());
-    data.remove();
-    data.close();
-}
+    auto store = WalletStore::getInstance();
+    store->clear(sentNamespace);
+    store->clear(minedNamespace);
+    store->commit();
 
-QList<TransactionItem> SentTxStore::readSentTxFile() {
-    QFile data(writeableFile());
-    if (!data.exists()) {
-        return QList<TransactionItem>();
-    }
-    
-    QJsonDocument jsonDoc;
-    
-    data.open(QFile::ReadOnly);    
-    jsonDoc = QJsonDocument::fromJson(data.readAll());
-    data.close();
+    QFile::remove(writeableFile());
 
-    QList<TransactionItem> items;
-
-    for (auto i : jsonDoc.array()) {
-        auto sentTx = i.toObject();
-        TransactionItem t{"send", (qint64)sentTx["datetime"].toVariant().toLongLong(), 
-                          sentTx["address"].toString(), 
-                          sentTx["txid"].toString(), 
-                          sentTx["amount"].toDouble() + sentTx["fee"].toDouble(), 
-                          0, sentTx["from"].toString(), ""};
-        items.push_back(t);
+    if (items != nullptr) {
+        items->clear();
+        rowByTxid.clear();
+        minedByTxid.clear();
     }
+}
 
-    return items;
+QList<TransactionItem> SentTxStore::readSentTxFile() {
+    load();
+
+    // QList is implicitly shared, so this doesn't copy anything until the next tx is added
+    return *items;
 }
 
 void SentTxStore::addToSentTx(Tx tx, QString txid) {
@@ -55,28 +54,12 @@ void SentTxStore::addToSentTx(Tx tx, QString txid) {
     if (!Settings::getInstance()->getSaveZtxs())
         return;
 
-    // Also, only store outgoing txs where the from address is a z-Addr. Else, regular commerciumd 
+    // Also, only store outgoing txs where the from address is a z-Addr. Else, regular commerciumd
     // stores it just fine
-    if (!tx.fromAddr.startsWith("z")) 
+    if (!tx.fromAddr.startsWith("z"))
         return;
 
-    QFile data(writeableFile());
-    QJsonDocument jsonDoc;
-
-    // If data doesn't exist, then create a blank one
-    if (!data.exists()) {
-        QJsonArray a;
-        jsonDoc.setArray(a);
-
-        QFile newFile(writeableFile());
-        newFile.open(QFile::WriteOnly);
-        newFile.write(jsonDoc.toJson());
-        newFile.close();
-    } else {
-        data.open(QFile::ReadOnly);    
-        jsonDoc = QJsonDocument().fromJson(data.readAll());
-        data.close();
-    }
+    load();
 
     // Calculate total amount in this tx
     double totalAmount = 0;
@@ -84,22 +67,135 @@ void SentTxStore::addToSentTx(Tx tx, QString txid) {
         totalAmount += i.amount;
     }
 
-    auto list = jsonDoc.array();
-    QJsonObject txItem;
-    txItem["type"]      = "sent";
-    txItem["from"]      = tx.fromAddr;
-    txItem["datetime"]  = QDateTime::currentMSecsSinceEpoch() / (qint64)1000;
-    txItem["address"]   = QString();    // The sent address is blank, to be consistent with t-Addr sent behaviour
-    txItem["txid"]      = txid;
-    txItem["amount"]    = -totalAmount;
-    txItem["fee"]       = -tx.fee;
-    list.append(txItem);
-
-    jsonDoc.setArray(list);
-
-    QFile writer(writeableFile());
-    if (writer.open(QFile::WriteOnly | QFile::Truncate)) {
-        writer.write(jsonDoc.toJson());
-    } 
-    writer.close();
+    // The sent address is blank, to be consistent with t-Addr sent behaviour
+    TransactionItem item{"send", QDateTime::currentMSecsSinceEpoch() / (qint64)1000, "", txid,
+                         -totalAmount - tx.fee, 0, tx.fromAddr, ""};
+
+    storeItem(item);
+
+    // A sent tx that is lost can't be recovered from commerciumd, so write it out right away
+    WalletStore::getInstance()->commit();
+
+    addItem(*items, rowByTxid, item);
+}
+
+QHash<QString, MinedBlock> SentTxStore::getMinedBlocks() {
+    load();
+    return minedByTxid;
+}
+
+void SentTxStore::setMinedBlock(const QString& txid, const MinedBlock& block) {
+    load();
+
+    auto it = minedByTxid.constFind(txid);
+    if (it != minedByTxid.constEnd() && it->height == block.height && it->hash == block.hash)
+        return;
+
+    storeMinedBlock(txid, block);
+    minedByTxid[txid] = block;
+}
+
+void SentTxStore::clearMinedBlock(const QString& txid) {
+    load();
+    if (!minedByTxid.contains(txid))
+        return;
+
+    WalletStore::getInstance()->remove(minedNamespace, txid);
+    minedByTxid.remove(txid);
+}
+
+/**
+ * Read the sent txs into memory, the first time they are needed (and again if we switch between
+ * mainnet and testnet). Sent txs from older versions of the wallet are migrated into the store.
+ */
+void SentTxStore::load() {
+    if (items != nullptr && loadedTestnet == Settings::getInstance()->isTestnet())
+        return;
+
+    delete items;
+    items = new QList<TransactionItem>();
+    rowByTxid.clear();
+    minedByTxid.clear();
+    loadedTestnet = Settings::getInstance()->isTestnet();
+
+    auto store = WalletStore::getInstance();
+    if (store->isEmpty(sentNamespace) && QFile::exists(writeableFile())) {
+        migrateFromFiles();
+    }
+
+    for (const auto& value : store->values(sentNamespace)) {
+        TransactionItem item{"send", 0, "", value.first, 0, 0, "", ""};
+        QDataStream in(value.second);
+        in >> item.datetime >> item.fromAddr >> item.amount;
+
+        addItem(*items, rowByTxid, item);
+    }
+
+    for (const auto& value : store->values(minedNamespace)) {
+        MinedBlock block{0, ""};
+        QDataStream in(value.second);
+        in >> block.height >> block.hash;
+
+        minedByTxid[value.first] = block;
+    }
+}
+
+void SentTxStore::storeItem(const TransactionItem& item) {
+    QByteArray value;
+    QDataStream out(&value, QIODevice::WriteOnly);
+    out << item.datetime << item.fromAddr << item.amount;
+
+    WalletStore::getInstance()->put(sentNamespace, item.txid, value);
+}
+
+void SentTxStore::storeMinedBlock(const QString& txid, const MinedBlock& block) {
+    QByteArray value;
+    QDataStream out(&value, QIODevice::WriteOnly);
+    out << (qint32)block.height << block.hash;
+
+    WalletStore::getInstance()->put(minedNamespace, txid, value);
+}
+
+// Move the sent txs from the JSON file written by older versions into the wallet store
+void SentTxStore::migrateFromFiles() {
+    QList<TransactionItem> oldItems;
+    readJson(writeableFile(), oldItems);
+
+    for (const auto& item : oldItems) {
+        storeItem(item);
+    }
+
+    // Only remove the old file once everything is safely in the store
+    if (WalletStore::getInstance()->sync()) {
+        QFile::remove(writeableFile());
+    }
+}
+
+void SentTxStore::readJson(const QString& filename, QList<TransactionItem>& items) {
+    QFile data(filename);
+    if (!data.open(QFile::ReadOnly))
+        return;
+
+    auto jsonDoc = QJsonDocument::fromJson(data.readAll());
+    data.close();
+
+    for (auto i : jsonDoc.array()) {
+        auto sentTx = i.toObject();
+        TransactionItem t{"send", (qint64)sentTx["datetime"].toVariant().toLongLong(),
+                          sentTx["address"].toString(),
+                          sentTx["txid"].toString(),
+                          sentTx["amount"].toDouble() + sentTx["fee"].toDouble(),
+                          0, sentTx["from"].toString(), ""};
+        items.push_back(t);
+    }
+}
+
+// Add the item, replacing any earlier one with the same txid
+void SentTxStore::addItem(QList<TransactionItem>& items, QHash<QString, int>& rows, const TransactionItem& item) {
+    if (rows.contains(item.txid)) {
+        items[rows[item.txid]] = item;
+    } else {
+        rows[item.txid] = items.size();
+        items.push_back(item);
+    }
 }
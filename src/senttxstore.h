@@ -5,6 +5,16 @@
 #include "mainwindow.h"
 #include "rpc.h"
 
+// The block a sent tx was mined in
+struct MinedBlock {
+    int     height;
+    QString hash;
+};
+
+/**
+ * Sent z-Addr transactions, which commerciumd doesn't remember for us. They are kept in the wallet
+ * store, one entry per txid, and cached in memory after the first read.
+ */
 class SentTxStore {
 public:
     static void deleteHistory();
@@ -12,9 +22,26 @@ public:
     static QList<TransactionItem> readSentTxFile();
     static void                   addToSentTx(Tx tx, QString txid);
 
+    // Blocks the sent txs were mined in, so their confirmations can be worked out from the tip
+    static QHash<QString, MinedBlock> getMinedBlocks();
+    static void                   setMinedBlock(const QString& txid, const MinedBlock& block);
+    static void                   clearMinedBlock(const QString& txid);
+
 private:
+    static void    load();
+    static void    migrateFromFiles();
+    static void    readJson(const QString& filename, QList<TransactionItem>& items);
+
+    static void    storeItem(const TransactionItem& item);
+    static void    storeMinedBlock(const QString& txid, const MinedBlock& block);
+    static void    addItem(QList<TransactionItem>& items, QHash<QString, int>& rows, const TransactionItem& item);
+
     static QString writeableFile();
-    
+
+    static QList<TransactionItem>*  items;          // nullptr until the store is read
+    static QHash<QString, int>      rowByTxid;
+    static QHash<QString, MinedBlock> minedByTxid;
+    static bool                     loadedTestnet;  // Which network the items were read for
 };
 
 #endif // SENTTXSTORE_H
@@ -1,11 +1,14 @@
 #include "mainwindow.h"
 #include "settings.h"
+#include "addressvalidator.h"
 
 Settings* Settings::instance = nullptr;
 
 Settings* Settings::init() {    
-    if (instance == nullptr) 
+    if (instance == nullptr) {
         instance = new Settings();
+        instance->loadSnapshot();
+    }
 
     return instance;
 }
@@ -14,16 +17,41 @@ Settings* Settings::getInstance() {
     return instance;
 }
 
-Config Settings::getSettings() {
-    // Load from the QT Settings. 
+// Read everything from the QT Settings once, instead of on every call
+void Settings::loadSnapshot() {
     QSettings s;
-    
-    auto host        = s.value("connection/host").toString();
-    auto port        = s.value("connection/port").toString();
-    auto username    = s.value("connection/rpcuser").toString();
-    auto password    = s.value("connection/rpcpassword").toString();    
 
-    return Config{host, port, username, password};
+    auto snap = std::make_shared<SettingsSnapshot>();
+    snap->connection = Config{ s.value("connection/host").toString(),
+                               s.value("connection/port").toString(),
+                               s.value("connection/rpcuser").toString(),
+                               s.value("connection/rpcpassword").toString() };
+    snap->saveZtxs          = s.value("options/savesenttx", true).toBool();
+    snap->autoShield        = s.value("options/autoshield", false).toBool();
+    snap->allowCustomFees   = s.value("options/customfees", false).toBool();
+    snap->paramDownloads    = s.value("options/paramdownloads", 2).toInt();
+    snap->paramSegments     = s.value("options/paramsegments", 4).toInt();
+    snap->monitorRssMB      = s.value("options/monitor/rssmb", 0).toInt();
+    snap->monitorCpuPercent = s.value("options/monitor/cpupercent", 0).toInt();
+    snap->monitorIoMBps     = s.value("options/monitor/iombps", 0).toInt();
+    snap->monitorFds        = s.value("options/monitor/fds", 0).toInt();
+    snap->throttlePolicy    = s.value("options/throttle", 0).toInt();
+    snap->syncRefreshBlocks = s.value("options/syncrefreshblocks", 10000).toInt();
+
+    std::atomic_store(&current, std::shared_ptr<const SettingsSnapshot>(snap));
+}
+
+// Publish a copy of the current snapshot with the change applied. Only called on the GUI thread.
+void Settings::publish(std::function<void(SettingsSnapshot&)> change) {
+    auto next = std::make_shared<SettingsSnapshot>(*snapshot());
+    change(*next);
+
+    std::atomic_store(&current, std::shared_ptr<const SettingsSnapshot>(next));
+    emit optionsChanged();
+}
+
+Config Settings::getSettings() {
+    return snapshot()->connection;
 }
 
 void Settings::saveSettings(const QString& host, const QString& port, const QString& username, const QString& password) {
@@ -36,8 +64,7 @@ void Settings::saveSettings(const QString& host, const QString& port, const QStr
 
     s.sync();
 
-    // re-init to load correct settings
-    init();
+    publish([=] (auto& snap) { snap.connection = Config{host, port, username, password}; });
 }
 
 void Settings::setUsingCommerciumConf(QString confLocation) {
@@ -54,32 +81,24 @@ void Settings::setTestnet(bool isTestnet) {
 }
 
 bool Settings::isSaplingAddress(QString addr) {
-    if (!isValidAddress(addr))
+    if (AddressValidator::classify(addr) != AddressValidator::Sapling)
         return false;
 
-    return ( isTestnet() && addr.startsWith("ztestsapling")) ||
-           (!isTestnet() && addr.startsWith("zs"));
+    return ( isTestnet() && addr.startsWith("ztestsapling", Qt::CaseInsensitive)) ||
+           (!isTestnet() && addr.startsWith("zs", Qt::CaseInsensitive));
 }
 
 bool Settings::isSproutAddress(QString addr) {
-    if (!isValidAddress(addr))
-        return false;
-        
-    return isZAddress(addr) && !isSaplingAddress(addr);
+    return AddressValidator::classify(addr) == AddressValidator::Sprout;
 }
 
 bool Settings::isZAddress(QString addr) {
-    if (!isValidAddress(addr))
-        return false;
-        
-    return addr.startsWith("z");
+    auto type = AddressValidator::classify(addr);
+    return type == AddressValidator::Sprout || type == AddressValidator::Sapling;
 }
 
 bool Settings::isTAddress(QString addr) {
-    if (!isValidAddress(addr))
-        return false;
-        
-    return addr.startsWith("t");
+    return AddressValidator::classify(addr) == AddressValidator::Transparent;
 }
 
 bool Settings::isSyncing() {
@@ -108,30 +127,39 @@ double Settings::getCMMPrice() {
 }
 
 bool Settings::getAutoShield() {
-    // Load from Qt settings
-    return QSettings().value("options/autoshield", false).toBool();
+    return snapshot()->autoShield;
 }
 
 void Settings::setAutoShield(bool allow) {
     QSettings().setValue("options/autoshield", allow);
+    publish([=] (auto& snap) { snap.autoShield = allow; });
 }
 
 bool Settings::getAllowCustomFees() {
-    // Load from the QT Settings. 
-    return QSettings().value("options/customfees", false).toBool();
+    return snapshot()->allowCustomFees;
 }
 
 void Settings::setAllowCustomFees(bool allow) {
     QSettings().setValue("options/customfees", allow);
+    publish([=] (auto& snap) { snap.allowCustomFees = allow; });
+}
+
+int Settings::getThrottlePolicy() {
+    return snapshot()->throttlePolicy;
+}
+
+void Settings::setThrottlePolicy(int policy) {
+    QSettings().setValue("options/throttle", policy);
+    publish([=] (auto& snap) { snap.throttlePolicy = policy; });
 }
 
 bool Settings::getSaveZtxs() {
-    // Load from the QT Settings. 
-    return QSettings().value("options/savesenttx", true).toBool();
+    return snapshot()->saveZtxs;
 }
 
 void Settings::setSaveZtxs(bool save) {
     QSettings().setValue("options/savesenttx", save);
+    publish([=] (auto& snap) { snap.saveZtxs = save; });
 }
 
 void Settings::setPeers(int peers) {
@@ -270,13 +298,7 @@ QString Settings::getZboardAddr() {
 }
 
 bool Settings::isValidAddress(QString addr) {
-    QRegExp zcexp("^z[a-z0-9]{94}$",  Qt::CaseInsensitive);
-    QRegExp zsexp("^z[a-z0-9]{77}$",  Qt::CaseInsensitive);
-    QRegExp ztsexp("^ztestsapling[a-z0-9]{76}", Qt::CaseInsensitive);
-    QRegExp texp("^t[a-z0-9]{34}$", Qt::CaseInsensitive);
-
-    return  zcexp.exactMatch(addr)  || texp.exactMatch(addr) || 
-            ztsexp.exactMatch(addr) || zsexp.exactMatch(addr);
+    return AddressValidator::isValid(addr);
 }
 
 const QString Settings::labelRegExp("[a-zA-Z0-9\\-_]{0,40}");
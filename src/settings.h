@@ -10,15 +10,41 @@ struct Config {
     QString rpcpassword;
 };
 
+// The options saved from the settings dialog. A snapshot is never changed once it is published,
+// so it can be read from any thread.
+struct SettingsSnapshot {
+    Config  connection;
+    bool    saveZtxs            = true;
+    bool    autoShield          = false;
+    bool    allowCustomFees     = false;
+    int     paramDownloads      = 2;    // Params files downloaded at once
+    int     paramSegments       = 4;    // Parallel range requests for each large params file
+
+    // When to log a warning about the embedded commerciumd's resource use. 0 is off.
+    int     monitorRssMB        = 0;
+    int     monitorCpuPercent   = 0;
+    int     monitorIoMBps       = 0;
+    int     monitorFds          = 0;
+
+    int     throttlePolicy      = 0;    // DaemonThrottle::Policy for the embedded commerciumd
+
+    // While syncing, only refresh the wallet every this many blocks. 0 refreshes on every block.
+    int     syncRefreshBlocks   = 10000;
+};
+
 struct ToFields;
 struct Tx;
 
-class Settings
+class Settings : public QObject
 {
+    Q_OBJECT
 public:
     static  Settings* init();
     static  Settings* getInstance();
 
+    // Lock free, so it's safe to call from any thread
+    std::shared_ptr<const SettingsSnapshot> snapshot() const { return std::atomic_load(&current); }
+
     Config  getSettings();
     void    saveSettings(const QString& host, const QString& port, const QString& username, const QString& password);
 
@@ -45,6 +71,9 @@ public:
 
     bool    getAllowCustomFees();
     void    setAllowCustomFees(bool allow);
+
+    int     getThrottlePolicy();
+    void    setThrottlePolicy(int policy);
             
     bool    isSaplingActive();
 
@@ -88,21 +117,30 @@ public:
     static const int     quickUpdateSpeed    = 5  * 1000;        // 5 sec
     static const int     priceRefreshSpeed   = 60 * 60 * 1000;   // 1 hr
 
+signals:
+    // Emitted on the GUI thread after a new snapshot is published
+    void    optionsChanged();
+
 private:
     // This class can only be accessed through Settings::getInstance()
     Settings() = default;
     ~Settings() = default;
 
+    void    loadSnapshot();
+    void    publish(std::function<void(SettingsSnapshot&)> change);
+
     static Settings* instance;
 
+    std::shared_ptr<const SettingsSnapshot> current;
+
     QString _confLocation;
     QString _executable;
-    bool    _isTestnet        = false;
-    bool    _isSyncing        = false;
-    int     _blockNumber      = 0;
-    bool    _useEmbedded      = false;
-    int     _peerConnections  = 0;
-    double cmmPrice = 0.0;
+    std::atomic<bool>   _isTestnet          {false};
+    std::atomic<bool>   _isSyncing          {false};
+    std::atomic<int>    _blockNumber        {0};
+    std::atomic<bool>   _useEmbedded        {false};
+    std::atomic<int>    _peerConnections    {0};
+    std::atomic<double> cmmPrice            {0.0};
 };
 
 #endif // SETTINGS_H
\ No newline at end of file
@@ -0,0 +1,50 @@
+#include "sparkline.h"
+
+Sparkline::Sparkline(QWidget* parent) :
+    QWidget(parent) {
+    setMinimumSize(120, 20);
+    setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Fixed);
+}
+
+void Sparkline::setValues(const QVector<double>& values, const QString& text) {
+    this->values = values;
+    this->text   = text;
+    update();
+}
+
+QSize Sparkline::sizeHint() const {
+    return QSize(240, qMax(20, fontMetrics().height() + 4));
+}
+
+/**
+ * The line takes whatever is left of the width after the text. It is scaled from 0 to the largest
+ * value, so a flat line at the bottom means nothing is happening.
+ */
+void Sparkline::paintEvent(QPaintEvent*) {
+    QPainter painter(this);
+    painter.setRenderHint(QPainter::Antialiasing);
+
+    int textWidth = fontMetrics().width(text) + 8;
+    painter.setPen(palette().color(QPalette::WindowText));
+    painter.drawText(QRect(width() - textWidth, 0, textWidth, height()), Qt::AlignRight | Qt::AlignVCenter, text);
+
+    QRectF area(1, 2, width() - textWidth - 2, height() - 4);
+    if (values.size() < 2 || area.width() < 2)
+        return;
+
+    double max = 0;
+    for (double v : values) {
+        max = qMax(max, v);
+    }
+    if (max <= 0)
+        max = 1;
+
+    QPolygonF line;
+    double step = area.width() / (values.size() - 1);
+    for (int i = 0; i < values.size(); i++) {
+        line << QPointF(area.left() + i * step, area.bottom() - values[i] / max * area.height());
+    }
+
+    painter.setPen(QPen(palette().color(QPalette::Highlight), 1.5));
+    painter.drawPolyline(line);
+}
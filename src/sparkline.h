@@ -0,0 +1,24 @@
+#ifndef SPARKLINE_H
+#define SPARKLINE_H
+
+#include "precompiled.h"
+
+// A small line chart of recent values, with the current value written next to it
+class Sparkline : public QWidget
+{
+    Q_OBJECT
+public:
+    explicit        Sparkline(QWidget *parent = 0);
+    void            setValues(const QVector<double>& values, const QString& text);
+
+    QSize           sizeHint() const override;
+
+protected:
+    void            paintEvent(QPaintEvent *) override;
+
+private:
+    QVector<double> values;
+    QString         text;
+};
+
+#endif // SPARKLINE_H
@@ -0,0 +1,97 @@
+#include "syncmonitor.h"
+#include "daemontuning.h"
+
+void SyncMonitor::addSample(int height, double progress) {
+    // A reorg or a different commerciumd would make the rates meaningless, so start again
+    if (!samples.isEmpty() && height < samples.last().height)
+        samples.clear();
+
+    samples.push_back(Sample{ QDateTime::currentMSecsSinceEpoch(), height, progress });
+    if (samples.size() > maxSamples)
+        samples.removeFirst();
+}
+
+int SyncMonitor::windowStart(qint64 windowMs) const {
+    qint64 from = samples.last().time - windowMs;
+
+    int i = samples.size() - 1;
+    while (i > 0 && samples[i - 1].time >= from)
+        i--;
+    return i;
+}
+
+SyncMonitor::Snapshot SyncMonitor::snapshot() const {
+    Snapshot snap{ 0, 0, 0, 0, 0, -1 };
+    if (samples.isEmpty())
+        return snap;
+
+    const Sample& last = samples.last();
+    snap.height   = last.height;
+    snap.progress = last.progress;
+
+    auto rates = [&] (qint64 windowMs, double& blocks, double& progress) {
+        const Sample& first = samples[windowStart(windowMs)];
+        double secs = (last.time - first.time) / 1000.0;
+        if (secs <= 0)
+            return;
+        blocks   = (last.height - first.height) / secs;
+        progress = (last.progress - first.progress) / secs;
+    };
+
+    double longProgress = 0;
+    rates(recentWindow, snap.recentBlocksPerSec, snap.recentProgressPerSec);
+    rates(longWindow, snap.blocksPerSec, longProgress);
+
+    // Prefer the recent rate, which reflects how dense the blocks are now
+    double rate = snap.recentProgressPerSec > 0 ? snap.recentProgressPerSec : longProgress;
+    if (rate > 0 && last.progress < 1)
+        snap.etaSecs = (qint64)((1 - last.progress) / rate);
+
+    return snap;
+}
+
+QVector<double> SyncMonitor::blocksPerSecSeries() const {
+    QVector<double> values;
+    for (int i = 1; i < samples.size(); i++) {
+        double secs = (samples[i].time - samples[i - 1].time) / 1000.0;
+        values.push_back(secs > 0 ? (samples[i].height - samples[i - 1].height) / secs : 0);
+    }
+    return values;
+}
+
+QJsonObject SyncMonitor::toJson() const {
+    auto hw   = DaemonTuning::detect(QDir::homePath());
+    auto snap = snapshot();
+
+    QJsonArray arr;
+    for (const auto& s : samples) {
+        arr.push_back(QJsonObject{ {"time", QString::number(s.time)}, {"height", s.height}, {"progress", s.progress} });
+    }
+
+    return QJsonObject{
+        {"machine", QJsonObject{ {"os", QSysInfo::prettyProductName()},
+                                 {"cores", hw.cores},
+                                 {"ramBytes", QString::number(hw.ramBytes)} }},
+        {"snapshot", QJsonObject{ {"height", snap.height},
+                                  {"progress", snap.progress},
+                                  {"recentBlocksPerSec", snap.recentBlocksPerSec},
+                                  {"blocksPerSec", snap.blocksPerSec},
+                                  {"recentProgressPerSec", snap.recentProgressPerSec},
+                                  {"etaSecs", QString::number(snap.etaSecs)} }},
+        {"samples", arr}
+    };
+}
+
+QString SyncMonitor::formatEta(qint64 secs) {
+    if (secs < 0)
+        return QObject::tr("unknown");
+    if (secs < 60)
+        return QObject::tr("less than a minute");
+
+    qint64 hours = secs / 3600, mins = (secs % 3600) / 60;
+    if (hours >= 48)
+        return QString::number(hours / 24) % QObject::tr(" days");
+    if (hours > 0)
+        return QString::number(hours) % "h " % QString::number(mins) % "m";
+    return QString::number(mins) % QObject::tr(" min");
+}
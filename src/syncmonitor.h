@@ -0,0 +1,57 @@
+#ifndef SYNCMONITOR_H
+#define SYNCMONITOR_H
+
+#include "precompiled.h"
+
+/**
+ * Keeps the block height and verification progress from each getblockchaininfo, and works out how
+ * fast the sync is going over a recent and a longer window.
+ *
+ * verificationprogress is based on transaction counts, so progress per second already slows down
+ * when the blocks get denser. The ETA uses that rate over the recent window, so it follows the
+ * current block density rather than the average since the sync started.
+ */
+class SyncMonitor
+{
+public:
+    struct Sample {
+        qint64  time;           // ms since epoch
+        int     height;
+        double  progress;       // verificationprogress, 0 to 1
+    };
+
+    struct Snapshot {
+        int     height;
+        double  progress;
+        double  recentBlocksPerSec;
+        double  blocksPerSec;           // Over the longer window
+        double  recentProgressPerSec;
+        qint64  etaSecs;                // -1 if it can't be worked out yet
+    };
+
+    void                    addSample(int height, double progress);
+    void                    clear() { samples.clear(); }
+
+    Snapshot                snapshot() const;
+    const QList<Sample>&    getSamples() const { return samples; }
+
+    // Blocks per second between each sample and the one before it, for the chart
+    QVector<double>         blocksPerSecSeries() const;
+
+    // The samples and the snapshot, with the machine they were taken on, so syncs can be compared
+    QJsonObject             toJson() const;
+
+    static QString          formatEta(qint64 secs);
+
+private:
+    // Index of the oldest sample within windowMs of the newest one
+    int                     windowStart(qint64 windowMs) const;
+
+    QList<Sample>           samples;
+
+    static const int        maxSamples      = 720;
+    static const qint64     recentWindow    = 3 * 60 * 1000;    // ms
+    static const qint64     longWindow      = 30 * 60 * 1000;
+};
+
+#endif // SYNCMONITOR_H
@@ -0,0 +1,158 @@
+/*
+ * Address validator vectors and timing. See addressvalidatortest.pro.
+ *
+ * The vectors were made with a separate Base58Check and BIP-173 Bech32 encoder, from random payloads
+ * with the mainnet and testnet prefixes. The invalid ones are each a valid address with one thing
+ * wrong with it.
+ */
+
+#include "addressvalidator.h"
+
+#include <cstdio>
+
+struct Vector {
+    const char*             addr;
+    AddressValidator::Type  type;
+    const char*             why;
+};
+
+static const Vector vectors[] = {
+    { "t1ZnqNoKLqz5etgQpqbJTddRgZUMdSnh77Q", AddressValidator::Transparent, "valid t-addr" },
+    { "t3aU4BpVmXE5raAFaJGqow3xeiDpiHNwegi", AddressValidator::Transparent, "valid t-addr" },
+    { "tmBVh2mhHsqiVyjygZ9k4mxdLKSSHGjT24U", AddressValidator::Transparent, "valid t-addr" },
+    { "t1Hsc1LR8yKnbbe3twRp88p6vFfC5t7DLbs", AddressValidator::Transparent, "valid t-addr, zero hash" },
+    { "zcFMfwjKw9usjDQToD42CwjU78xrAxnux8NC6aiGrySSQux8h97vPrrv6nQboYJKpHRqh9Et2whkSjmkxyMse8Jrhx7gu43", AddressValidator::Sprout, "valid Sprout z-addr" },
+    { "ztJw7wwXTvy5eNTApnLwLudDipkifVf6AJJH4R6ecXtKLo2sfkg5rhyw1gQD7J8tinmFrD2LwvQm2aXk9wXndxuMbDm5K5u", AddressValidator::Sprout, "valid Sprout z-addr" },
+    { "zs1awvs4kxe3wkvuv4c7lvyegcp7dzffq7lqapf0am38p2lmswnnedlwdx75tw9emsam90hcdy25zq", AddressValidator::Sapling, "valid Sapling z-addr" },
+    { "zs17ug75u56n68ls248ewfmw9jg5egsjlfyuq9mhw6s7p6f3yck0k7lqtp9k402mm03xg4zslulclp", AddressValidator::Sapling, "valid Sapling z-addr" },
+    { "ztestsapling180e4r4sn90ed987drdr85wqeqnmpchyvqret62z5uzn84jy2zw4gky0nfvaxg0u44jgsugfzkms", AddressValidator::Sapling, "valid Sapling z-addr" },
+    { "ztestsapling1dtghln2y7g4dtp55qa6arzwf5g605yp88al8gu678m9zj8xgy72a8vqzgxe854fghcn0zhmec86", AddressValidator::Sapling, "valid Sapling z-addr" },
+    { "ZS1YTN2DMXC6ZF833CFZSRCF0ERPWR2Y0UKGZUWKSYVECLR5LW0FPDUH0R90HT7DXRA5ENFKPNMRSN", AddressValidator::Sapling, "valid, all uppercase" },
+    { "t1Vn69kscCtpB7cVRpiT5TxsMaLyCsw89WB", AddressValidator::Invalid, "t-addr, one character changed" },
+    { "t1Vn69kscCtpB7cVRpiT4TxsMaLyCsw89WC", AddressValidator::Invalid, "t-addr, last character changed" },
+    { "t1Vn69kscCtpB7cVRpiT4TxsMaLyCsw89W", AddressValidator::Invalid, "t-addr, too short" },
+    { "t1Vn69kscCtpB7cVRpiT4TxsMaLyCsw89WB1", AddressValidator::Invalid, "t-addr, too long" },
+    { "t1Vn69kscC0pB7cVRpiT4TxsMaLyCsw89WB", AddressValidator::Invalid, "t-addr, 0 is not Base58" },
+    { "t1Vn69kscClpB7cVRpiT4TxsMaLyCsw89WB", AddressValidator::Invalid, "t-addr, l is not Base58" },
+    { "zcNqLHBMwLwTpLdrHF7nDaejj9MEaCbYaw2MQktrQYsewxba8ekJcj3z3vdBGFPUkZ2WcNcUb4qK7vR58qnPHR5n6e9m4ec", AddressValidator::Invalid, "Sprout, one character changed" },
+    { "zcNqLHBMwLwTpLdrHF7nDaejj9MEaCbYaw2MQktrQYsewxba8ejJcj3z3vdBGFPUkZ2WcNcUb4qK7vR58qnPHR5n6e9m4e", AddressValidator::Invalid, "Sprout, too short" },
+    { "zcNqLOBMwLwTpLdrHF7nDaejj9MEaCbYaw2MQktrQYsewxba8ejJcj3z3vdBGFPUkZ2WcNcUb4qK7vR58qnPHR5n6e9m4ec", AddressValidator::Invalid, "Sprout, O is not Base58" },
+    { "zs168lvtf7madqv82pnexyav7nt70juxkaauwz2khcs5m4zf3ny3wrltuhz0nxlhs7tk7r36wh949l", AddressValidator::Invalid, "Sapling, one character changed" },
+    { "zs168lvtf7madqv82pnexyav7nt70juxkaauwz2kcks5m4zf3ny3wrltuhz0nxlhs7tk7r36wh949l", AddressValidator::Invalid, "Sapling, two characters swapped" },
+    { "zs168lvtf7madqv82pnexyav7nt70juxkaauwz2kkcs5m4zf3ny3wrltuhz0nxlhs7tk7r36wh949", AddressValidator::Invalid, "Sapling, too short" },
+    { "zs168lvtf7madqv82pnexyav7nt70juxkaauwz2kkcs5m4zf3ny3wrltuhz0nxlhs7tk7r36wh949lq", AddressValidator::Invalid, "Sapling, too long" },
+    { "zs168lvtf7madqv82pnexyav7nt70jbxkaauwz2kkcs5m4zf3ny3wrltuhz0nxlhs7tk7r36wh949l", AddressValidator::Invalid, "Sapling, b is not Bech32" },
+    { "zs168lvtf7madqv82pnexyav7nt70juxkaauwz2kkcs5m4zf3nY3WRLTUHZ0NXLHS7TK7R36WH949L", AddressValidator::Invalid, "Sapling, mixed case in the data" },
+    { "Zs168lvtf7madqv82pnexyav7nt70juxkaauwz2kkcs5m4zf3ny3wrltuhz0nxlhs7tk7r36wh949l", AddressValidator::Invalid, "Sapling, mixed case between the HRP and the data" },
+    { "zS168lvtf7madqv82pnexyav7nt70juxkaauwz2kkcs5m4zf3ny3wrltuhz0nxlhs7tk7r36wh949l", AddressValidator::Invalid, "Sapling, mixed case within the HRP" },
+    { "zt19wt2gqfdsxujejanq04rkdre3uf5jflew4l0gtqq5s4h02yy2de562xur6lfnpfq3e3h7myw2y6", AddressValidator::Invalid, "checksum valid, but zt is not a Sapling HRP" },
+    { "zs1jzkv4ce8vpsz7805857lwrdmmcg5m7ah2hzez8k2usup5jfc29tfjlhc2q5gf7xhjv48wz5cpae", AddressValidator::Invalid, "data checksummed for ztestsapling, under zs" },
+    { "zs1zcfradsdzdkawj29srgshsyutmxynyv349myy6y8l6l90p2eh6l0sunegfzxh7gawv4tndpe4uv", AddressValidator::Invalid, "Sapling, padding bit set" },
+    { "zs16y780crn296yktnermtq8lvhsf8v3tqx29fuwchdhp0ka8sz9t2ejczgpaewr54zm6wqwkl7m2", AddressValidator::Invalid, "Sapling, 42 byte payload" },
+    { "", AddressValidator::Invalid, "empty" },
+};
+
+// The checks Settings::isValidAddress made before the validator
+static bool regexIsValid(const QString& addr) {
+    QRegExp zcexp("^z[a-z0-9]{94}$",  Qt::CaseInsensitive);
+    QRegExp zsexp("^z[a-z0-9]{77}$",  Qt::CaseInsensitive);
+    QRegExp ztsexp("^ztestsapling[a-z0-9]{76}", Qt::CaseInsensitive);
+    QRegExp texp("^t[a-z0-9]{34}$", Qt::CaseInsensitive);
+
+    return  zcexp.exactMatch(addr)  || texp.exactMatch(addr) ||
+            ztsexp.exactMatch(addr) || zsexp.exactMatch(addr);
+}
+
+static const char* typeName(AddressValidator::Type type) {
+    switch (type) {
+    case AddressValidator::Transparent: return "Transparent";
+    case AddressValidator::Sprout:      return "Sprout";
+    case AddressValidator::Sapling:     return "Sapling";
+    default:                            return "Invalid";
+    }
+}
+
+static int check() {
+    int failures = 0;
+    int count    = 0;
+    QStringList addrs;
+    for (const auto& v : vectors) {
+        auto addr = QString::fromLatin1(v.addr);
+        auto type = AddressValidator::classify(addr);
+        if (type != v.type) {
+            std::printf("FAIL: %s\n      %s: expected %s, got %s\n", v.addr, v.why, typeName(v.type), typeName(type));
+            failures++;
+        }
+
+        addrs.push_back(addr);
+        count++;
+    }
+
+    // The list version has to agree, including when it's split across threads
+    while (addrs.size() < 5000) {
+        addrs += addrs;
+    }
+    auto types = AddressValidator::classify(addrs);
+    for (int i = 0; i < addrs.size(); i++) {
+        if (types[i] != vectors[i % count].type) {
+            std::printf("FAIL: classifying a list of %d, %s at %d: expected %s, got %s\n", addrs.size(),
+                        vectors[i % count].why, i, typeName(vectors[i % count].type), typeName(types[i]));
+            failures++;
+            break;
+        }
+    }
+
+    if (failures == 0)
+        std::printf("All %d vectors pass\n", count);
+    return failures == 0 ? 0 : 1;
+}
+
+static void report(const char* what, int count, qint64 ns) {
+    std::printf("%-36s %9.1f ms  %8.0f ns per address\n", what, ns / 1000000.0, count > 0 ? (double)ns / count : 0);
+}
+
+static int bench(int count) {
+    QStringList addrs;
+    for (int i = 0; i < count; i++) {
+        addrs.push_back(QString::fromLatin1(vectors[i % (sizeof(vectors) / sizeof(vectors[0]))].addr));
+    }
+
+    std::printf("%d addresses, the vectors repeated\n\n", count);
+
+    // Keep the results, so none of the work is optimised away
+    int valid = 0;
+
+    QElapsedTimer timer;
+    timer.start();
+    for (const auto& addr : addrs) {
+        valid += regexIsValid(addr);
+    }
+    report("regular expressions", count, timer.nsecsElapsed());
+
+    timer.restart();
+    for (const auto& addr : addrs) {
+        valid += AddressValidator::isValid(addr);
+    }
+    report("validator, one at a time", count, timer.nsecsElapsed());
+
+    timer.restart();
+    auto types = AddressValidator::classify(addrs);
+    report("validator, as one list", count, timer.nsecsElapsed());
+
+    for (auto type : types) {
+        valid += type != AddressValidator::Invalid;
+    }
+    std::printf("\n%d passed\n", valid);
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    QCoreApplication app(argc, argv);
+
+    if (argc > 1 && QString(argv[1]) == "bench") {
+        int count = argc > 2 ? QString(argv[2]).toInt() : 100000;
+        return bench(count > 0 ? count : 100000);
+    }
+
+    return check();
+}
@@ -0,0 +1,17 @@
+# Checks the address validator against Base58Check and Bech32 vectors, and times it against the regular
+# expressions it replaced. Not part of the wallet build.
+#
+#   ./addressvalidatortest                  Check every vector
+#   ./addressvalidatortest bench [count]    Time the regular expressions and the validator on count
+#                                           addresses, one at a time and as one list
+
+include(../tests.pri)
+
+TARGET = addressvalidatortest
+
+SOURCES += \
+    addressvalidatortest.cpp \
+    ../../addressvalidator.cpp
+
+HEADERS += \
+    ../../addressvalidator.h
@@ -0,0 +1,124 @@
+/*
+ * Times each log call on the calling thread. See loggertest.pro.
+ *
+ * The logger this replaced formatted the line and wrote and flushed it to the file inside write(),
+ * so that is timed first, written out the same way here. Then Logger::write with the line enabled,
+ * which only copies it into the ring, and LOG with the line's level turned off, which shouldn't even
+ * build the message.
+ *
+ * The calls are made back to back, faster than the writer thread drains the ring, so some enabled
+ * lines are dropped. The number of lines that made it to the file is reported with the timings.
+ */
+
+#include "logger.h"
+
+#include <cstdio>
+
+// As Logger::write did before it was asynchronous
+static void oldWrite(QFile* file, const QString& value) {
+    QString text = value;
+    text = QDateTime::currentDateTime().toString("dd.MM.yyyy hh:mm:ss ") + text;
+    QTextStream out(file);
+    out.setCodec("UTF-8");
+    out << text << endl;
+}
+
+// A line like the ones the connection code logs
+static QString message(int i) {
+    return QString("Sent getinfo, reply in %1 ms, block %2").arg(i % 97).arg(410000 + i);
+}
+
+static void report(const char* what, QVector<qint64> ns) {
+    std::sort(ns.begin(), ns.end());
+
+    double total = 0;
+    for (auto t : ns) {
+        total += t;
+    }
+
+    std::printf("%-36s %8.0f ns mean  %8lld ns median  %8lld ns p99  %10lld ns max\n", what,
+                total / ns.size(), (long long)ns[ns.size() / 2], (long long)ns[ns.size() * 99 / 100], (long long)ns.last());
+}
+
+// Lines in the file written by message()
+static int countMessages(const QString& name) {
+    QFile file(name);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        return 0;
+
+    int lines = 0;
+    for (QByteArray line = file.readLine(); !line.isEmpty(); line = file.readLine()) {
+        lines += line.contains("Sent getinfo");
+    }
+    return lines;
+}
+
+int main(int argc, char* argv[]) {
+    QCoreApplication app(argc, argv);
+
+    int count = argc > 1 ? QString(argv[1]).toInt() : 20000;
+    if (count <= 0)
+        count = 20000;
+
+    QTemporaryDir dir;
+    if (!dir.isValid()) {
+        std::printf("FAIL: couldn't make a temporary directory\n");
+        return 1;
+    }
+
+    std::printf("%d calls each, in %s\n\n", count, dir.path().toUtf8().constData());
+
+    QVector<qint64> ns(count);
+    QElapsedTimer timer;
+
+    // The old synchronous write
+    {
+        QFile file(dir.filePath("old.log"));
+        file.open(QIODevice::Append | QIODevice::Text);
+
+        for (int i = 0; i < count; i++) {
+            auto text = message(i);
+            timer.start();
+            oldWrite(&file, text);
+            ns[i] = timer.nsecsElapsed();
+        }
+        report("old: format, write and flush", ns);
+    }
+
+    // Enabled, into the ring
+    int kept = 0;
+    {
+        auto logger = new Logger(nullptr, dir.filePath("enabled.log"));
+
+        for (int i = 0; i < count; i++) {
+            auto text = message(i);
+            timer.start();
+            LOG(logger, Info, Connection, text);
+            ns[i] = timer.nsecsElapsed();
+        }
+        report("LOG, enabled", ns);
+
+        // Stops the writer once everything left in the ring is written out
+        delete logger;
+
+        kept = countMessages(dir.filePath("enabled.log"));
+    }
+
+    // Disabled, so the message is never built
+    {
+        auto logger = new Logger(nullptr, dir.filePath("disabled.log"));
+        logger->setLevel(Logger::Warning);
+
+        for (int i = 0; i < count; i++) {
+            timer.start();
+            LOG(logger, Info, Connection, message(i));
+            ns[i] = timer.nsecsElapsed();
+        }
+        report("LOG, level disabled", ns);
+
+        delete logger;
+    }
+
+    std::printf("\n%d of the %d enabled lines were written, the rest were dropped with the ring full\n", kept, count);
+    return 0;
+}
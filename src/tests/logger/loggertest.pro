@@ -0,0 +1,15 @@
+# Times what a log call costs the thread that makes it, which is usually the GUI thread. Not part of
+# the wallet build.
+#
+#   ./loggertest [count]        Time count calls each way, 20000 by default
+
+include(../tests.pri)
+
+TARGET = loggertest
+
+SOURCES += \
+    loggertest.cpp \
+    ../../logger.cpp
+
+HEADERS += \
+    ../../logger.h
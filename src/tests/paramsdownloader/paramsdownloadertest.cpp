@@ -0,0 +1,382 @@
+/*
+ * Downloads params-sized files with ParamsDownloader from a local HTTP stand-in, and checks every
+ * byte that ends up on disk. See paramsdownloadertest.pro.
+ *
+ * The stand-in works out the content of each file from the offset, so even a full-size param set
+ * doesn't have to be kept in memory. It can limit each connection's speed, cut every connection
+ * off after a number of bytes, and ignore Range headers while still advertising them.
+ */
+
+#include "paramsdownloader.h"
+#include "ioexecutor.h"
+
+#include <cstdio>
+#include <QEventLoop>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTemporaryDir>
+
+struct ServedFile {
+    QString name;
+    qint64  size;
+};
+
+// Byte offset of every served file, mixed with the file's index (splitmix64)
+static void fillContent(int fileIndex, qint64 offset, char* buf, qint64 len) {
+    qint64 i = 0;
+    while (i < len) {
+        quint64 x = (quint64)((offset + i) / 8) * 0x9E3779B97F4A7C15ULL + (quint64)(fileIndex + 1) * 0xBF58476D1CE4E5B9ULL;
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+        x =  x ^ (x >> 31);
+
+        for (int b = (int)((offset + i) % 8); b < 8 && i < len; b++, i++)
+            buf[i] = (char)(x >> (8 * b));
+    }
+}
+
+class StandInServer : public QObject {
+public:
+    QList<ServedFile>   files;
+    bool                ranges          = true;     // If false, Range is advertised but the whole file is sent
+    double              rate            = 0;        // Bytes per second for each connection, 0 for no limit
+    qint64              cutOffAfter     = -1;       // Drop every connection once this many bytes were sent
+    qint64              sent            = 0;        // Body bytes, across all connections
+    int                 rangeRequests   = 0;
+
+    bool listen() {
+        QObject::connect(&server, &QTcpServer::newConnection, this, [=] () { accept(); });
+        return server.listen(QHostAddress::LocalHost);
+    }
+
+    QUrl url(const QString& name) const {
+        return QUrl("http://127.0.0.1:" % QString::number(server.serverPort()) % "/" % name);
+    }
+
+private:
+    struct Transfer {
+        QTcpSocket*     socket;
+        QByteArray      request;
+        int             file        = -1;
+        qint64          pos         = 0;
+        qint64          end         = -1;       // Inclusive
+        qint64          sentHere    = 0;
+        QElapsedTimer   started;
+    };
+
+    void accept() {
+        while (server.hasPendingConnections()) {
+            auto t = std::make_shared<Transfer>();
+            t->socket = server.nextPendingConnection();
+            QObject::connect(t->socket, &QTcpSocket::readyRead,    this, [=] () { readRequest(t); });
+            QObject::connect(t->socket, &QTcpSocket::bytesWritten, this, [=] () { pump(t); });
+            QObject::connect(t->socket, &QTcpSocket::disconnected, t->socket, &QObject::deleteLater);
+        }
+    }
+
+    // One request per connection, which is closed after the response
+    void readRequest(std::shared_ptr<Transfer> t) {
+        t->request += t->socket->readAll();
+        int headerEnd = t->request.indexOf("\r\n\r\n");
+        if (headerEnd < 0 || t->file >= 0)
+            return;
+
+        auto lines  = t->request.left(headerEnd).split('\n');
+        auto parts  = lines[0].trimmed().split(' ');
+        auto method = parts.value(0);
+        auto path   = parts.value(1);
+
+        int index = -1;
+        for (int i = 0; i < files.size(); i++) {
+            if (path == "/" + files[i].name.toUtf8())
+                index = i;
+        }
+        if (index < 0) {
+            t->socket->write("HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+            t->socket->disconnectFromHost();
+            return;
+        }
+
+        qint64 size = files[index].size, start = 0, end = size - 1;
+        bool partial = false;
+        for (const auto& line : lines) {
+            auto header = line.trimmed();
+            if (!ranges || !header.toLower().startsWith("range: bytes="))
+                continue;
+
+            auto range = header.mid(13).split('-');
+            start = range[0].toLongLong();
+            if (range.size() > 1 && !range[1].isEmpty())
+                end = qMin(range[1].toLongLong(), size - 1);
+            partial = true;
+            rangeRequests++;
+        }
+
+        QByteArray head = partial ? "HTTP/1.1 206 Partial Content\r\n" : "HTTP/1.1 200 OK\r\n";
+        head += "Accept-Ranges: bytes\r\nContent-Type: application/octet-stream\r\n";
+        head += "Content-Length: " + QByteArray::number(end - start + 1) + "\r\n";
+        if (partial)
+            head += "Content-Range: bytes " + QByteArray::number(start) + "-" + QByteArray::number(end) + "/" + QByteArray::number(size) + "\r\n";
+        head += "Connection: close\r\n\r\n";
+        t->socket->write(head);
+
+        if (method != "GET") {
+            t->socket->disconnectFromHost();
+            return;
+        }
+
+        t->file = index;
+        t->pos  = start;
+        t->end  = end;
+        t->started.start();
+        pump(t);
+    }
+
+    // Write more of the body, keeping a few chunks queued on the socket
+    void pump(std::shared_ptr<Transfer> t) {
+        if (t->file < 0)
+            return;
+
+        while (t->pos <= t->end && t->socket->bytesToWrite() < 4 * chunkSize) {
+            qint64 n = qMin<qint64>(chunkSize, t->end - t->pos + 1);
+            if (rate > 0) {
+                qint64 allowed = (qint64)(rate * t->started.elapsed() / 1000) - t->sentHere;
+                if (allowed <= 0) {
+                    QTimer::singleShot(5, t->socket, [=] () { pump(t); });
+                    return;
+                }
+                n = qMin(n, allowed);
+            }
+
+            if (cutOffAfter >= 0 && sent + n > cutOffAfter) {
+                t->file = -1;
+                t->socket->abort();
+                return;
+            }
+
+            QByteArray buf((int)n, Qt::Uninitialized);
+            fillContent(t->file, t->pos, buf.data(), n);
+            t->socket->write(buf);
+
+            t->pos      += n;
+            t->sentHere += n;
+            sent        += n;
+        }
+
+        if (t->pos > t->end) {
+            t->file = -1;
+            t->socket->disconnectFromHost();
+        }
+    }
+
+    QTcpServer server;
+
+    static const qint64 chunkSize = 64 * 1024;
+};
+
+// Download everything the server has into dir. Returns the error, or an empty string.
+static QString download(const StandInServer& server, const QString& dir, int parallel, int segments, double* secs = nullptr) {
+    QList<QUrl> urls;
+    for (const auto& f : server.files) {
+        urls.push_back(server.url(f.name));
+    }
+
+    QEventLoop loop;
+    QString result;
+    bool finished = false;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    auto downloader = new ParamsDownloader(nullptr, dir, urls, parallel, segments);
+    downloader->start([] (const ParamsDownloader::Progress&) {}, [&] (QString error) {
+        result   = error;
+        finished = true;
+        downloader->deleteLater();
+        loop.quit();
+    });
+    if (!finished)
+        loop.exec();
+
+    if (secs)
+        *secs = timer.elapsed() / 1000.0;
+
+    // Let the last state files and closes land before looking at the directory
+    IOExecutor::getInstance()->waitForIdle();
+    return result;
+}
+
+// Every file is complete, has the served content, and nothing was left behind
+static QString compare(const StandInServer& server, const QString& dir) {
+    QByteArray actual, expected;
+    for (int i = 0; i < server.files.size(); i++) {
+        auto name = QDir(dir).filePath(server.files[i].name);
+        if (QFile::exists(name % ".part") || QFile::exists(name % ".part.state"))
+            return server.files[i].name % " left a .part or .part.state file behind";
+
+        QFile file(name);
+        if (!file.open(QIODevice::ReadOnly))
+            return server.files[i].name % " is missing";
+        if (file.size() != server.files[i].size)
+            return server.files[i].name % " is " % QString::number(file.size()) % " bytes instead of " % QString::number(server.files[i].size);
+
+        for (qint64 pos = 0; pos < file.size(); pos += actual.size()) {
+            actual = file.read(4 * 1024 * 1024);
+            if (actual.isEmpty())
+                return server.files[i].name % " couldn't be read";
+
+            expected.resize(actual.size());
+            fillContent(i, pos, expected.data(), expected.size());
+            if (actual != expected)
+                return server.files[i].name % " differs somewhere after byte " % QString::number(pos);
+        }
+    }
+
+    return QString();
+}
+
+// Write the first length bytes of a file as a leftover .part, or garbage if length is past the end
+static void writePart(const StandInServer& server, const QString& dir, int i, qint64 length) {
+    QFile file(QDir(dir).filePath(server.files[i].name) % ".part");
+    file.open(QIODevice::WriteOnly | QIODevice::Truncate);
+
+    QByteArray buf((int)qMin<qint64>(length, server.files[i].size), Qt::Uninitialized);
+    fillContent(i, 0, buf.data(), buf.size());
+    file.write(buf);
+    file.write(QByteArray((int)(length - buf.size()), 'x'));
+}
+
+static int failures = 0;
+
+static void report(const QString& name, const QString& problem) {
+    if (problem.isEmpty()) {
+        std::printf("ok    %s\n", name.toUtf8().constData());
+    } else {
+        std::printf("FAIL  %s: %s\n", name.toUtf8().constData(), problem.toUtf8().constData());
+        failures++;
+    }
+}
+
+static int check() {
+    StandInServer server;
+    server.files = {
+        { "small.params-test",  100 * 1024 + 7 },
+        { "large-a.params-test", 40 * 1024 * 1024 + 3 },       // Two segments
+        { "large-b.params-test", 70 * 1024 * 1024 + 11 },      // Four segments
+    };
+    if (!server.listen()) {
+        std::printf("Couldn't listen on localhost\n");
+        return 1;
+    }
+
+    qint64 total = 0;
+    for (const auto& f : server.files) {
+        total += f.size;
+    }
+
+    {
+        QTemporaryDir dir;
+        server.rangeRequests = 0;
+        auto error = download(server, dir.path(), 2, 4);
+        report("fresh download in segments", error.isEmpty() ? compare(server, dir.path()) : error);
+        report("segments used range requests", server.rangeRequests > 0 ? QString() : "no Range headers were sent");
+    }
+
+    {
+        QTemporaryDir dir;
+        writePart(server, dir.path(), 0, 50 * 1024);                            // Resumed single stream
+        writePart(server, dir.path(), 1, 12 * 1024 * 1024);                    // Resumed single stream, hashed aside
+        writePart(server, dir.path(), 2, server.files[2].size + 1024 * 1024);  // Stale and too long
+        server.sent = 0;
+        auto error = download(server, dir.path(), 2, 4);
+        report("resume from .part files", error.isEmpty() ? compare(server, dir.path()) : error);
+    }
+
+    {
+        QTemporaryDir dir;
+        server.sent        = 0;
+        server.cutOffAfter = total / 3;
+        auto error = download(server, dir.path(), 2, 4);
+        report("interrupted download fails", error.isEmpty() ? "it succeeded" : QString());
+
+        server.sent        = 0;
+        server.cutOffAfter = -1;
+        error = download(server, dir.path(), 2, 4);
+        report("interrupted download resumes", error.isEmpty() ? compare(server, dir.path()) : error);
+        report("resume skipped what was already there", server.sent < total ? QString() :
+               QString("fetched %1 of %2 bytes again").arg(server.sent).arg(total));
+    }
+
+    {
+        QTemporaryDir dir;
+        server.ranges = false;
+        auto error = download(server, dir.path(), 2, 4);
+        report("server that ignores ranges", error.isEmpty() ? compare(server, dir.path()) : error);
+        server.ranges = true;
+    }
+
+    return failures == 0 ? 0 : 1;
+}
+
+// The real param set's sizes, under names ParamsVerifier has no digest for
+static int bench(double mbPerSec) {
+    StandInServer server;
+    server.files = {
+        { "sapling-output.params-test",     3592860   },
+        { "sapling-spend.params-test",      47958396  },
+        { "sprout-proving.key-test",        910173851 },
+        { "sprout-verifying.key-test",      1449      },
+        { "sprout-groth16.params-test",     725523612 },
+    };
+    server.rate = mbPerSec * 1024 * 1024;
+    if (!server.listen()) {
+        std::printf("Couldn't listen on localhost\n");
+        return 1;
+    }
+
+    qint64 total = 0;
+    for (const auto& f : server.files) {
+        total += f.size;
+    }
+
+    std::printf("%.1f MB in %d files, %s\n", total / 1048576.0, server.files.size(),
+                mbPerSec > 0 ? QString("%1 MB/s per connection").arg(mbPerSec).toUtf8().constData() : "no speed limit");
+
+    struct { const char* name; int parallel; int segments; } runs[] = {
+        { "one file at a time, one stream",     1, 1 },
+        { "2 files at a time, 4 segments each", 2, 4 },
+        { "5 files at a time, 8 segments each", 5, 8 },
+    };
+
+    for (const auto& run : runs) {
+        QTemporaryDir dir;
+        double secs = 0;
+        auto error = download(server, dir.path(), run.parallel, run.segments, &secs);
+        if (error.isEmpty())
+            error = compare(server, dir.path());
+
+        if (!error.isEmpty()) {
+            std::printf("%-40s FAIL: %s\n", run.name, error.toUtf8().constData());
+            return 1;
+        }
+        std::printf("%-40s %7.2f s  %8.1f MB/s\n", run.name, secs, total / 1048576.0 / secs);
+    }
+
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    QCoreApplication app(argc, argv);
+
+    // Created here, so its done callbacks run on this thread
+    IOExecutor::getInstance();
+
+    int result;
+    if (argc > 1 && QString(argv[1]) == "bench")
+        result = bench(argc > 2 ? QString(argv[2]).toDouble() : 0);
+    else
+        result = check();
+
+    IOExecutor::getInstance()->shutdown();
+    return result;
+}
@@ -0,0 +1,21 @@
+# Downloads params-sized files from a local HTTP stand-in and checks them byte for byte. Not part of
+# the wallet build.
+#
+#   ./paramsdownloadertest                  Fresh, resumed, interrupted and range-ignoring downloads
+#   ./paramsdownloadertest bench [MB/s]     Time a full-size param set, one at a time and in parallel,
+#                                           optionally limiting each connection to MB/s
+
+include(../tests.pri)
+
+TARGET = paramsdownloadertest
+
+SOURCES += \
+    paramsdownloadertest.cpp \
+    ../../paramsdownloader.cpp \
+    ../../paramsverifier.cpp \
+    ../../ioexecutor.cpp
+
+HEADERS += \
+    ../../paramsdownloader.h \
+    ../../paramsverifier.h \
+    ../../ioexecutor.h
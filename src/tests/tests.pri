@@ -0,0 +1,18 @@
+# Shared by the test and benchmark harnesses in this directory. Each one is a small console program
+# built on its own against the wallet's sources, and none of them are part of the wallet build:
+#
+#   cd src/tests/<harness> && qmake && make && ./<harness>
+
+QT       += core gui widgets network
+
+CONFIG   += c++14 console
+CONFIG   -= app_bundle
+
+TEMPLATE  = app
+
+DEFINES  += QT_DEPRECATED_WARNINGS
+
+INCLUDEPATH += $$PWD/.. $$PWD/../3rdparty
+
+OBJECTS_DIR = bin
+MOC_DIR     = bin
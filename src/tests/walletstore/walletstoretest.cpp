@@ -0,0 +1,200 @@
+/*
+ * Times the wallet store against the files it replaced. See walletstoretest.pro.
+ *
+ * The old address book rewrote addresslabels.dat with every label, and the old sent tx store read
+ * and rewrote the whole of senttxstore.dat for every tx, neither with an fsync. The wallet store
+ * appends one fsync'd batch per commit. Labels are grouped into a batch until control returns to
+ * the event loop, so they are timed as one batch; sent txs are committed one at a time, as
+ * SentTxStore does.
+ *
+ * Opening is timed after switching the store away to the other network's file and back, so the
+ * file is opened, mapped and replayed again. The OS has it cached, as it would when the wallet
+ * restarts, so this is a warm-cache open.
+ */
+
+#include "walletstore.h"
+#include "settings.h"
+#include "ioexecutor.h"
+
+#include <cstdio>
+
+// The same namespaces the wallet uses
+static const QString labelsNamespace = QStringLiteral("addressbook");
+static const QString sentNamespace   = QStringLiteral("senttxs");
+
+struct SentTx {
+    QString txid;
+    qint64  datetime;
+    QString fromAddr;
+    double  amount;
+};
+
+static QString fakeAddress(int i) {
+    return "zs1" % QString::number(i).rightJustified(8, '0') % QString(67, 'q');
+}
+
+static QString fakeTxid(int i) {
+    return QString::fromLatin1(QCryptographicHash::hash(QByteArray::number(i), QCryptographicHash::Sha256).toHex());
+}
+
+// As AddressBook::writeToStorage did, after every change
+static void oldWriteLabels(const QString& name, const QList<QPair<QString, QString>>& labels) {
+    QFile file(name);
+    file.open(QIODevice::ReadWrite | QIODevice::Truncate);
+    QDataStream out(&file);
+    out << QString("v1") << labels;
+    file.close();
+}
+
+// As SentTxStore::addToSentTx did: read the whole file, add the tx, and write it all back
+static void oldAddSentTx(const QString& name, const SentTx& tx) {
+    QJsonDocument jsonDoc;
+
+    QFile data(name);
+    if (data.open(QFile::ReadOnly)) {
+        jsonDoc = QJsonDocument::fromJson(data.readAll());
+        data.close();
+    }
+
+    auto list = jsonDoc.array();
+    QJsonObject txItem;
+    txItem["type"]      = "sent";
+    txItem["from"]      = tx.fromAddr;
+    txItem["datetime"]  = tx.datetime;
+    txItem["address"]   = QString();
+    txItem["txid"]      = tx.txid;
+    txItem["amount"]    = tx.amount;
+    txItem["fee"]       = -0.0001;
+    list.append(txItem);
+    jsonDoc.setArray(list);
+
+    QFile writer(name);
+    if (writer.open(QFile::WriteOnly | QFile::Truncate))
+        writer.write(jsonDoc.toJson());
+    writer.close();
+}
+
+static int oldReadAll(const QString& labelsName, const QString& sentName) {
+    QList<QPair<QString, QString>> labels;
+    QFile file(labelsName);
+    if (file.open(QIODevice::ReadOnly)) {
+        QDataStream in(&file);
+        QString version;
+        in >> version >> labels;
+    }
+
+    int count = labels.size();
+    QFile data(sentName);
+    if (data.open(QFile::ReadOnly)) {
+        for (auto i : QJsonDocument::fromJson(data.readAll()).array()) {
+            auto sentTx = i.toObject();
+            count += !sentTx["txid"].toString().isEmpty();
+        }
+    }
+
+    return count;
+}
+
+static void report(const char* what, int count, double ms) {
+    std::printf("%-44s %9.1f ms  %10.0f /s\n", what, ms, ms > 0 ? count * 1000.0 / ms : 0);
+}
+
+static double elapsedMs(const QElapsedTimer& timer) {
+    return timer.nsecsElapsed() / 1000000.0;
+}
+
+int main(int argc, char* argv[]) {
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setOrganizationName("cmm-qt-wallet-tests");
+    QCoreApplication::setApplicationName("walletstoretest");
+
+    // Keeps the files (and QSettings) away from the real wallet's
+    QStandardPaths::setTestModeEnabled(true);
+
+    int count = argc > 1 ? QString(argv[1]).toInt() : 2000;
+    if (count <= 0)
+        count = 2000;
+
+    QDir dir(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation));
+    dir.removeRecursively();
+    QDir().mkpath(dir.absolutePath());
+
+    IOExecutor::getInstance();
+    Settings::init();
+
+    QList<QPair<QString, QString>> labels;
+    QList<SentTx> txs;
+    for (int i = 0; i < count; i++) {
+        labels.push_back(QPair<QString, QString>("label-" % QString::number(i), fakeAddress(i)));
+        txs.push_back(SentTx{ fakeTxid(i), 1546300800 + i, fakeAddress(i + count), -1.5 - i });
+    }
+
+    std::printf("%d labels and %d sent txs, in %s\n\n", count, count, dir.absolutePath().toUtf8().constData());
+
+    // The old files
+    auto labelsName = dir.filePath("addresslabels.dat");
+    auto sentName   = dir.filePath("senttxstore.dat");
+
+    QElapsedTimer timer;
+    timer.start();
+    QList<QPair<QString, QString>> written;
+    for (const auto& label : labels) {
+        written.push_back(label);
+        oldWriteLabels(labelsName, written);
+    }
+    report("old: labels, file rewritten for each", count, elapsedMs(timer));
+
+    timer.restart();
+    for (const auto& tx : txs) {
+        oldAddSentTx(sentName, tx);
+    }
+    report("old: sent txs, file rewritten for each", count, elapsedMs(timer));
+
+    timer.restart();
+    int read = oldReadAll(labelsName, sentName);
+    report("old: read everything back", read, elapsedMs(timer));
+
+    std::printf("\n");
+
+    // The wallet store
+    auto store = WalletStore::getInstance();
+
+    timer.restart();
+    for (const auto& label : labels) {
+        store->put(labelsNamespace, label.first, label.second.toUtf8());
+    }
+    store->sync();
+    report("store: labels, in one batch", count, elapsedMs(timer));
+
+    timer.restart();
+    for (const auto& tx : txs) {
+        QByteArray value;
+        QDataStream out(&value, QIODevice::WriteOnly);
+        out << tx.datetime << tx.fromAddr << tx.amount;
+
+        store->put(sentNamespace, tx.txid, value);
+        store->commit();
+    }
+    store->sync();
+    report("store: sent txs, one fsync'd commit each", count, elapsedMs(timer));
+
+    // Let the commits finish on this thread, so the new batches are mapped
+    QCoreApplication::processEvents();
+
+    Settings::getInstance()->setTestnet(true);
+    store->switchNetwork();
+    Settings::getInstance()->setTestnet(false);
+
+    timer.restart();
+    store->switchNetwork();
+    read = store->values(labelsNamespace).size() + store->values(sentNamespace).size();
+    report("store: open and read everything back", read, elapsedMs(timer));
+
+    int result = read == 2 * count ? 0 : 1;
+    if (result != 0)
+        std::printf("\nFAIL: read %d entries back instead of %d\n", read, 2 * count);
+
+    IOExecutor::getInstance()->shutdown();
+    dir.removeRecursively();
+    return result;
+}
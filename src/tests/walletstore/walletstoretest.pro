@@ -0,0 +1,24 @@
+# Times the wallet store against the address label and sent tx files it replaced. Not part of the
+# wallet build.
+#
+#   ./walletstoretest [count]       Write count labels and sent txs (2000 by default), then read
+#                                   them back from a freshly opened file
+
+include(../tests.pri)
+
+TARGET = walletstoretest
+
+SOURCES += \
+    walletstoretest.cpp \
+    ../../walletstore.cpp \
+    ../../ioexecutor.cpp \
+    ../../settings.cpp \
+    ../../addressvalidator.cpp \
+    ../../logger.cpp
+
+HEADERS += \
+    ../../walletstore.h \
+    ../../ioexecutor.h \
+    ../../settings.h \
+    ../../addressvalidator.h \
+    ../../logger.h
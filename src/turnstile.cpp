@@ -3,6 +3,7 @@
 #include "balancestablemodel.h"
 #include "rpc.h"
 #include "settings.h"
+#include "walletstore.h"
 
 using json = nlohmann::json;
 
@@ -33,7 +34,19 @@ QString Turnstile::writeableFile() {
     }
 }
 
+// Where the plan is kept in the wallet store
+static const QString storeNamespace = QStringLiteral("turnstile");
+static const QString storeKey       = QStringLiteral("plan");
+
 void Turnstile::removeFile() {
+    plan.clear();
+    planLoaded  = true;
+    planTestnet = Settings::getInstance()->isTestnet();
+
+    auto store = WalletStore::getInstance();
+    store->remove(storeNamespace, storeKey);
+    store->commit();
+
     QFile(writeableFile()).remove();
 }
 
@@ -49,37 +62,82 @@ QDataStream &operator>>(QDataStream& ds, TurnstileMigrationItem& item) {
                  >> item.destAddr >> item.amount >> item.blockNumber >> item.status;
 }
 
-void Turnstile::writeMigrationPlan(QList<TurnstileMigrationItem> plan) {
+void Turnstile::writeMigrationPlan(QList<TurnstileMigrationItem> newPlan) {
     //qDebug() << QString("Writing plan");
-    printPlan(plan);
+    printPlan(newPlan);
 
-    QFile file(writeableFile());
-    file.open(QIODevice::ReadWrite | QIODevice::Truncate);
-    QDataStream out(&file);   // we will serialize the data into the file
+    // Sort to see when the next step is.
+    std::sort(newPlan.begin(), newPlan.end(), [&] (auto a, auto b) {
+        return a.blockNumber < b.blockNumber;
+    });        
+
+    plan        = newPlan;
+    planLoaded  = true;
+    planTestnet = Settings::getInstance()->isTestnet();
+    saveMigrationPlan();
+}
+
+// Write the plan to the wallet store, and commit right away, since a step that is forgotten would
+// be sent again.
+void Turnstile::saveMigrationPlan() {
+    QByteArray value;
+    QDataStream out(&value, QIODevice::WriteOnly);
     out << plan;
-    file.close();
+
+    auto store = WalletStore::getInstance();
+    store->put(storeNamespace, storeKey, value);
+    store->commit();
 }
 
-QList<TurnstileMigrationItem> Turnstile::readMigrationPlan() {
-    QFile file(writeableFile());
-    
-    QList<TurnstileMigrationItem> plan;
-    if (!file.exists()) return plan;
+// Read the plan the first time it is needed, or if we switched between mainnet and testnet
+void Turnstile::loadMigrationPlan() {
+    if (planLoaded && planTestnet == Settings::getInstance()->isTestnet())
+        return;
+
+    plan.clear();
+    planLoaded  = true;
+    planTestnet = Settings::getInstance()->isTestnet();
 
-    file.open(QIODevice::ReadOnly);
-    QDataStream in(&file);    // read the data serialized from the file
-    in >> plan; 
+    auto store = WalletStore::getInstance();
+    if (store->contains(storeNamespace, storeKey)) {
+        QDataStream in(store->value(storeNamespace, storeKey));
+        in >> plan;
+    } else {
+        // Plans written by older versions are in their own file
+        QFile file(writeableFile());
+        if (!file.open(QIODevice::ReadOnly)) 
+            return;
 
-    file.close();
+        QDataStream in(&file);    // read the data serialized from the file
+        in >> plan; 
+        file.close();
+
+        saveMigrationPlan();
+        if (store->sync())
+            file.remove();
+    }
 
     // Sort to see when the next step is.
     std::sort(plan.begin(), plan.end(), [&] (auto a, auto b) {
         return a.blockNumber < b.blockNumber;
     });        
+}
 
+QList<TurnstileMigrationItem> Turnstile::readMigrationPlan() {
+    loadMigrationPlan();
     return plan;
 }
 
+// Called when a tx for a step is sent. The plan might have been aborted or replaced in the meantime,
+// so make sure it is still the same step.
+void Turnstile::setStepStatus(int index, const QString& intTAddr, int status) {
+    if (index >= plan.size() || plan[index].intTAddr != intTAddr)
+        return;
+
+    plan[index].status = status;
+    saveMigrationPlan();
+}
+
 void Turnstile::planMigration(QString zaddr, QString destAddr, int numsplits, int numBlocks) {
     // First, get the balance and split up the amounts
     auto bal = rpc->getAllBalances()->value(zaddr);
@@ -213,12 +271,14 @@ Turnstile::getNextStep(QList<TurnstileMigrationItem>& plan) {
 }
 
 bool Turnstile::isMigrationPresent() {
-    auto plan = readMigrationPlan();
+    loadMigrationPlan();
     return !plan.isEmpty();
 }
 
 ProgressReport Turnstile::getPlanProgress() {
-    auto plan = readMigrationPlan();
+    loadMigrationPlan();
+    if (plan.isEmpty())
+        return ProgressReport{0, 0, 0, false, "", "", ""};
 
     auto nextStep = getNextStep(plan);
 
@@ -246,7 +306,7 @@ void Turnstile::executeMigrationStep() {
     if (Settings::getInstance()->isSyncing())
         return;
 
-    auto plan = readMigrationPlan();
+    loadMigrationPlan();
 
     //qDebug() << QString("Executing step");
     printPlan(plan);
@@ -274,6 +334,10 @@ void Turnstile::executeMigrationStep() {
     if (nextStep->blockNumber > Settings::getInstance()->getBlockNumber()) 
         return;
 
+    // Remember which step this is, for when the tx has been sent
+    int     stepIndex    = std::distance(plan.begin(), nextStep);
+    QString stepIntTAddr = nextStep->intTAddr;
+
     // Is this the last step for this address?
     auto lastStep = std::find_if(std::next(nextStep), plan.end(), fnIsEligibleItem) == plan.end();
 
@@ -289,7 +353,7 @@ void Turnstile::executeMigrationStep() {
         if (nextStep->amount > balance) {
             qDebug() << "Not enough balance!";
             nextStep->status = TurnstileMigrationItemStatus::NotEnoughBalance;
-            writeMigrationPlan(plan);
+            saveMigrationPlan();
             return;
         }
 
@@ -309,8 +373,7 @@ void Turnstile::executeMigrationStep() {
         // And send it
         doSendTx(tx, [=] () {
             // Update status and write plan to disk
-            nextStep->status = TurnstileMigrationItemStatus::SentToT;
-            writeMigrationPlan(plan);
+            setStepStatus(stepIndex, stepIntTAddr, TurnstileMigrationItemStatus::SentToT);
         });
     } else if (nextStep->status == TurnstileMigrationItemStatus::SentToT) {
         // First thing to do is check to see if the funds are confirmed. 
@@ -332,7 +395,7 @@ void Turnstile::executeMigrationStep() {
         if (sendAmt < 0) {
             qDebug() << "Not enough balance!." << bal << ":" << sendAmt;
             nextStep->status = TurnstileMigrationItemStatus::NotEnoughBalance;
-            writeMigrationPlan(plan);
+            saveMigrationPlan();
             return;
         }
         
@@ -344,8 +407,7 @@ void Turnstile::executeMigrationStep() {
         // And send it
         doSendTx(tx, [=] () {
             // Update status and write plan to disk
-            nextStep->status = TurnstileMigrationItemStatus::SentToZS;
-            writeMigrationPlan(plan);
+            setStepStatus(stepIndex, stepIntTAddr, TurnstileMigrationItemStatus::SentToZS);
         });
     }
 }
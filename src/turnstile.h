@@ -45,7 +45,7 @@ public:
     void               fillAmounts(QList<double>& amounts, double amount, int count);
 
     QList<TurnstileMigrationItem> readMigrationPlan();
-    void               writeMigrationPlan(QList<TurnstileMigrationItem> plan);
+    void               writeMigrationPlan(QList<TurnstileMigrationItem> newPlan);
     void               removeFile();
     
     void               executeMigrationStep();
@@ -57,6 +57,10 @@ private:
     QList<int>          getBlockNumbers(int start, int end, int count);
     QString             writeableFile();
 
+    void                loadMigrationPlan();
+    void                saveMigrationPlan();
+    void                setStepStatus(int index, const QString& intTAddr, int status);
+
     void                doSendTx(Tx tx, std::function<void(void)> cb);
 
 
@@ -64,6 +68,11 @@ private:
 
     RPC*         rpc;    
     MainWindow* mainwindow;
+
+    // The plan is read from disk once, and written back only when a step changes state.
+    QList<TurnstileMigrationItem> plan;
+    bool                          planLoaded    = false;
+    bool                          planTestnet   = false;    // Which network the plan was read for
 };
 
 #endif
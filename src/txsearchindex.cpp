@@ -0,0 +1,76 @@
+#include "txsearchindex.h"
+#include "rpc.h"
+
+bool TxFilter::isEmpty() const {
+    return text.isEmpty() && type.isEmpty() && fromTime <= 0 && toTime <= 0 &&
+           minAmount < 0 && maxAmount < 0;
+}
+
+void TxSearchIndex::insert(int id, const TransactionItem& item) {
+    auto addr = item.address.trimmed().toLower();
+    if (!addr.isEmpty())
+        pending.push_back(Entry{ addr, id });
+
+    if (!item.txid.isEmpty())
+        pending.push_back(Entry{ item.txid.toLower(), id });
+}
+
+void TxSearchIndex::remove(int id) {
+    removed.insert(id);
+}
+
+/**
+ * Apply all the pending inserts and removes. The new entries are sorted on their own and then
+ * merged into the existing (already sorted) entries, so a refresh that brings in k new rows costs
+ * O(n + k log k) rather than a full re-sort.
+ */
+void TxSearchIndex::commit() {
+    if (!removed.isEmpty()) {
+        entries.erase(std::remove_if(entries.begin(), entries.end(), [=] (const Entry& e) {
+            return removed.contains(e.id);
+        }), entries.end());
+
+        // A row can be removed before it was ever committed
+        pending.erase(std::remove_if(pending.begin(), pending.end(), [=] (const Entry& e) {
+            return removed.contains(e.id);
+        }), pending.end());
+
+        removed.clear();
+    }
+
+    if (pending.empty())
+        return;
+
+    std::sort(pending.begin(), pending.end());
+
+    auto mid = entries.size();
+    entries.insert(entries.end(), std::make_move_iterator(pending.begin()), std::make_move_iterator(pending.end()));
+    std::inplace_merge(entries.begin(), entries.begin() + mid, entries.end());
+
+    pending.clear();
+}
+
+void TxSearchIndex::clear() {
+    entries.clear();
+    pending.clear();
+    removed.clear();
+}
+
+QVector<int> TxSearchIndex::lookupPrefix(const QString& prefix) const {
+    QVector<int> ids;
+
+    auto key   = prefix.trimmed().toLower();
+    if (key.isEmpty())
+        return ids;
+
+    auto start = std::lower_bound(entries.begin(), entries.end(), Entry{ key, 0 });
+    for (auto it = start; it != entries.end() && it->key.startsWith(key); it++) {
+        ids.push_back(it->id);
+    }
+
+    // A row can match on both its address and txid
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+
+    return ids;
+}
@@ -0,0 +1,48 @@
+#ifndef TXSEARCHINDEX_H
+#define TXSEARCHINDEX_H
+
+#include "precompiled.h"
+
+struct TransactionItem;
+
+// Filter for the transactions table. Fields that are left empty/unbounded match everything.
+struct TxFilter {
+    QString text;                   // Address or txid prefix
+    QString type;                   // "send", "receive", "generate"... Empty for all types
+    qint64  fromTime    = 0;        // Inclusive, seconds since epoch. 0 for unbounded
+    qint64  toTime      = 0;        // Inclusive, seconds since epoch. 0 for unbounded
+    double  minAmount   = -1;       // Compared against the absolute amount. Negative for unbounded
+    double  maxAmount   = -1;
+
+    bool isEmpty() const;
+};
+
+/**
+ * Prefix index over the address and txid of every row in the transactions table. Rows are
+ * identified by a stable id handed out by the model, so that the index can be updated
+ * incrementally as new rows are merged in, instead of being rebuilt (or scanned) on every keystroke.
+ */
+class TxSearchIndex {
+public:
+    void         insert(int id, const TransactionItem& item);
+    void         remove(int id);
+    void         commit();
+    void         clear();
+
+    // Ids of all rows whose address or txid starts with the prefix (case insensitive), sorted.
+    QVector<int> lookupPrefix(const QString& prefix) const;
+
+private:
+    struct Entry {
+        QString key;
+        int     id;
+
+        bool operator<(const Entry& other) const { return key < other.key; }
+    };
+
+    std::vector<Entry>  entries;    // Sorted by key
+    std::vector<Entry>  pending;    // Inserted, but not yet merged into entries
+    QSet<int>           removed;    // Removed, but not yet dropped from entries
+};
+
+#endif // TXSEARCHINDEX_H
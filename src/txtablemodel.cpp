@@ -1,6 +1,7 @@
 #include "txtablemodel.h"
 #include "settings.h"
 #include "rpc.h"
+#include "ioexecutor.h"
 
 TxTableModel::TxTableModel(QObject *parent)
      : QAbstractTableModel(parent) {
@@ -15,6 +16,7 @@ TxTableModel::~TxTableModel() {
 }
 
 void TxTableModel::addZSentData(const QList<TransactionItem>& data) {
+    zsIds = assignIds(zsTrans, zsIds, data);
     delete zsTrans;
     zsTrans = new QList<TransactionItem>();
     std::copy(data.begin(), data.end(), std::back_inserter(*zsTrans));
@@ -23,6 +25,7 @@ void TxTableModel::addZSentData(const QList<TransactionItem>& data) {
 }
 
 void TxTableModel::addZRecvData(const QList<TransactionItem>& data) {
+    zrIds = assignIds(zrTrans, zrIds, data);
     delete zrTrans;
     zrTrans = new QList<TransactionItem>();
     std::copy(data.begin(), data.end(), std::back_inserter(*zrTrans));
@@ -31,23 +34,148 @@ void TxTableModel::addZRecvData(const QList<TransactionItem>& data) {
 }
 
 
-void TxTableModel::addTData(const QList<TransactionItem>& data) {
+// Rows are the same transaction if these match. A tx that sends to several addresses has a row for each.
+static QString txKey(const TransactionItem& tx) {
+    return tx.type % tx.txid % tx.address;
+}
+
+/**
+ * A refresh only fetches the newest page of t-transactions. If the node has more than that, the older
+ * pages that were already loaded are kept after it, less anything the new page has, so scrolling back 
+ * (or a search) doesn't have to load them again.
+ */
+void TxTableModel::addTData(const QList<TransactionItem>& data, bool hasMore) {
+    QSet<QString> pageKeys;
+    for (const auto& tx : data) {
+        pageKeys.insert(txKey(tx));
+    }
+
+    QList<TransactionItem> next = data;
+    bool keptOlder = false;
+    if (hasMore && tTrans != nullptr) {
+        for (const auto& tx : *tTrans) {
+            if (!pageKeys.contains(txKey(tx))) {
+                next.push_back(tx);
+                keptOlder = true;
+            }
+        }
+    }
+
+    // Every row that was there is either in the new page or kept, so the keys only grow
+    if (keptOlder) {
+        tKeys.unite(pageKeys);
+    } else {
+        tKeys    = pageKeys;
+        tHasMore = hasMore;
+    }
+
+    tIds = assignIds(tTrans, tIds, next);
     delete tTrans;
     tTrans = new QList<TransactionItem>();
-    std::copy(data.begin(), data.end(), std::back_inserter(*tTrans));
+    std::copy(next.begin(), next.end(), std::back_inserter(*tTrans));
 
     updateAllData();
 }
 
-bool TxTableModel::exportToCsv(QString fileName) const {
-    if (!modeldata)
-        return false;
+// Add a page of older t-transactions that was requested through the page fetcher
+void TxTableModel::appendTData(const QList<TransactionItem>& data, bool hasMore) {
+    tFetchInProgress = false;
+
+    // The page was asked for before the pages it follows were dropped
+    if (tDiscardFetch) {
+        tDiscardFetch = false;
+        return;
+    }
+
+    tHasMore = hasMore;
+
+    if (tTrans == nullptr)
+        tTrans = new QList<TransactionItem>();
+
+    // With no t-transactions loaded there's nothing to compare the page against
+    bool   allOlder = !tTrans->isEmpty();
+    qint64 oldest   = 0;
+    if (allOlder) {
+        oldest = std::min_element(tTrans->begin(), tTrans->end(), [=] (auto a, auto b) {
+            return a.datetime < b.datetime;
+        })->datetime;
+    }
+
+    // New transactions may have arrived since the previous page was fetched, which shifts the 
+    // pages by a few items, so skip anything we already have.
+    int added = 0;
+    for (const auto& tx : data) {
+        if (tKeys.contains(txKey(tx)))
+            continue;
+
+        added++;
+        allOlder = allOlder && tx.datetime < oldest;
+        tKeys.insert(txKey(tx));
+        tTrans->push_back(tx);
+        tIds.push_back(nextId);
+        searchIndex.insert(nextId++, tx);
+    }
+
+    // Show the new page right away, the user scrolled down to get it. If the page is older than every
+    // row we had, which it normally is, it's sorted in after all of the rows on screen, so they can
+    // be left alone and the new ones inserted below them.
+    int shown = rowCount(QModelIndex());
+    if (allOlder) {
+        rebuildModelData();
+
+        int more = std::min(shown + (int)pageSize, availableRows()) - shown;
+        if (more > 0) {
+            beginInsertRows(QModelIndex(), shown, shown + more - 1);
+            exposedRows = shown + more;
+            endInsertRows();
+        }
+    } else {
+        exposedRows = shown + pageSize;
+        updateAllData();
+    }
 
-    QFile file(fileName);
-    if (!file.open(QIODevice::ReadWrite | QIODevice::Truncate))
+    // A page with nothing new would be asked for again, so stop there
+    if (added > 0)
+        fetchAllForFilter();
+}
+
+/**
+ * Drop the t-transactions past the first page, eg. the ones a search loaded once it's cleared. Returns
+ * false if there was nothing to drop. The caller has to rebuild the model data.
+ */
+bool TxTableModel::trimTData() {
+    if (tTrans == nullptr || tTrans->size() <= pageSize)
         return false;
 
-    QTextStream out(&file);   // we will serialize the data into the file
+    for (int i = pageSize; i < tTrans->size(); i++) {
+        tKeys.remove(txKey(tTrans->at(i)));
+        searchIndex.remove(tIds[i]);
+    }
+    tTrans->erase(tTrans->begin() + pageSize, tTrans->end());
+    tIds.resize(pageSize);
+
+    tHasMore      = true;
+    tDiscardFetch = tFetchInProgress;
+    return true;
+}
+
+// A search has to see the whole history, so while a filter is active keep loading older pages
+// until there are none left
+void TxTableModel::fetchAllForFilter() {
+    if (filterActive && tHasMore && !tFetchInProgress && tPageFetcher) {
+        tFetchInProgress = true;
+        tPageFetcher(tDataCount(), searchPageSize);
+    }
+}
+
+void TxTableModel::exportToCsv(QString fileName, std::function<void(bool)> done) const {
+    if (!modeldata) {
+        done(false);
+        return;
+    }
+
+    QString csv;
+    QTextStream out(&csv);    // we will serialize the data into a string, and write it out on the I/O thread
 
     // Write headers
     for (int i = 0; i < headers.length(); i++) {
@@ -56,46 +184,284 @@ bool TxTableModel::exportToCsv(QString fileName) const {
     out << "\"Memo\"";
     out << endl;
     
-    // Write out each row
+    // Write out each row. This always exports the full history, even if a filter is active.
     for (int row = 0; row < modeldata->length(); row++) {
-        for (int col = 0; col < headers.length(); col++) {
-            out << "\"" << data(index(row, col), Qt::DisplayRole).toString() << "\",";
-        }
+        const auto& dat = modeldata->at(row);
+        out << "\"" << dat.type << "\",";
+        out << "\"" << (dat.address.trimmed().isEmpty() ? "(Shielded)" : dat.address) << "\",";
+        out << "\"" << QDateTime::fromMSecsSinceEpoch(dat.datetime * (qint64)1000).toLocalTime().toString() << "\",";
+        out << "\"" << Settings::getCMMDisplayFormat(dat.amount) << "\",";
         // Memo
-        out << "\"" << modeldata->at(row).memo << "\"";
+        out << "\"" << dat.memo << "\"";
         out << endl;
     }
-
-    file.close();
-    return true;
+    out.flush();
+
+    auto ok = std::make_shared<bool>(false);
+    auto contents = csv.toUtf8();
+    IOExecutor::getInstance()->submit([=] () {
+        QFile file(fileName);
+        if (!file.open(QIODevice::ReadWrite | QIODevice::Truncate))
+            return;
+
+        *ok = file.write(contents) == contents.size();
+        file.close();
+    }, [=] () {
+        done(*ok);
+    });
 }
 
-void TxTableModel::updateAllData() {    
-    auto newmodeldata = new QList<TransactionItem>();
+void TxTableModel::updateAllData() {
+    rebuildModelData();
 
-    if (tTrans  != nullptr) std::copy( tTrans->begin(),  tTrans->end(), std::back_inserter(*newmodeldata));
-    if (zsTrans != nullptr) std::copy(zsTrans->begin(), zsTrans->end(), std::back_inserter(*newmodeldata));
-    if (zrTrans != nullptr) std::copy(zrTrans->begin(), zrTrans->end(), std::back_inserter(*newmodeldata));
+    dataChanged(index(0, 0), index(rowCount(QModelIndex())-1, columnCount(index(0,0))-1));
+    layoutChanged();
+}
+
+// Merge and sort the t, z sent and z received rows into modeldata, without telling the view
+void TxTableModel::rebuildModelData() {
+    // If most of the ids handed out so far are gone (eg. after a "No Connection" cleared the table),
+    // start over with fresh ids, so idToRow doesn't keep growing.
+    int total = tIds.size() + zsIds.size() + zrIds.size();
+    if (nextId > 2 * total + 1024)
+        reassignIds();
+
+    // Merge the lists, keeping each row's id with it
+    QList<TransactionItem> merged;
+    QVector<int>           mergedIds;
+    auto add = [&] (const QList<TransactionItem>* list, const QVector<int>& ids) {
+        if (list == nullptr) return;
+        merged.append(*list);
+        mergedIds += ids;
+    };
+    add(tTrans,  tIds);
+    add(zsTrans, zsIds);
+    add(zrTrans, zrIds);
 
     // Sort by reverse time
-    std::sort(newmodeldata->begin(), newmodeldata->end(), [=] (auto a, auto b) {
-        return a.datetime > b.datetime; // reverse sort
+    QVector<int> order(merged.size());
+    for (int i = 0; i < order.size(); i++) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&] (int a, int b) {
+        return merged[a].datetime > merged[b].datetime; // reverse sort
     });
 
+    auto newmodeldata = new QList<TransactionItem>();
+    newmodeldata->reserve(order.size());
+    idToRow.fill(-1, nextId);
+    for (int row = 0; row < order.size(); row++) {
+        newmodeldata->push_back(merged[order[row]]);
+        idToRow[mergedIds[order[row]]] = row;
+    }
+
     // And then swap out the modeldata with the new one.
     delete modeldata;
     modeldata = newmodeldata;
 
-    dataChanged(index(0, 0), index(modeldata->size()-1, columnCount(index(0,0))-1));
-    layoutChanged();
+    // While the node has older t-transactions that we haven't loaded yet, only show rows down to the
+    // oldest loaded t-transaction. Otherwise older z-transactions would be shown, and the t-transactions
+    // between them would pop in later.
+    cutoffRow = modeldata->size();
+    if (tHasMore && tTrans != nullptr && !tTrans->isEmpty()) {
+        auto oldest = std::min_element(tTrans->begin(), tTrans->end(), [=] (auto a, auto b) {
+            return a.datetime < b.datetime;
+        })->datetime;
+
+        cutoffRow = std::lower_bound(modeldata->constBegin(), modeldata->constEnd(), oldest, 
+            [=] (const TransactionItem& t, qint64 time) {
+                return t.datetime >= time;
+            }) - modeldata->constBegin();
+    }
+
+    searchIndex.commit();
+    applyFilter();
+}
+
+/**
+ * Give each row of next a stable id. A refresh mostly returns the previous rows with a few new ones 
+ * in front, so the two lists are walked side by side and a row that matches the previous row keeps 
+ * its id. Only rows that didn't match are added to the search index, and only the previous rows 
+ * that weren't matched are removed from it.
+ */
+QVector<int> TxTableModel::assignIds(const QList<TransactionItem>* prev, const QVector<int>& prevIds,
+                                     const QList<TransactionItem>& next) {
+    auto same = [] (const TransactionItem& a, const TransactionItem& b) {
+        return a.txid == b.txid && a.address == b.address && a.type == b.type;
+    };
+
+    int          prevSize = prev == nullptr ? 0 : prev->size();
+    QVector<int> ids(next.size());
+    QVector<bool> kept(prevSize, false);
+
+    int j = 0;
+    for (int i = 0; i < next.size(); i++) {
+        // Step over a previous row that has gone away
+        if (j + 1 < prevSize && !same(next[i], prev->at(j)) && same(next[i], prev->at(j + 1)))
+            j++;
+
+        if (j < prevSize && same(next[i], prev->at(j))) {
+            ids[i]  = prevIds[j];
+            kept[j] = true;
+            j++;
+        } else {
+            ids[i] = nextId++;
+            searchIndex.insert(ids[i], next[i]);
+        }
+    }
+
+    for (int k = 0; k < prevSize; k++) {
+        if (!kept[k])
+            searchIndex.remove(prevIds[k]);
+    }
+
+    return ids;
+}
+
+// Hand out fresh ids to every row, and rebuild the search index with them
+void TxTableModel::reassignIds() {
+    searchIndex.clear();
+    nextId = 0;
+
+    auto reassign = [&] (const QList<TransactionItem>* list, QVector<int>& ids) {
+        ids.clear();
+        if (list == nullptr) return;
+        for (const auto& item : *list) {
+            ids.push_back(nextId);
+            searchIndex.insert(nextId++, item);
+        }
+    };
+    reassign(tTrans,  tIds);
+    reassign(zsTrans, zsIds);
+    reassign(zrTrans, zrIds);
+}
+
+// The number of rows changes, so the view has to be reset rather than just re-laid out. When a search
+// is cleared, the older pages it loaded are dropped again.
+void TxTableModel::setFilter(const TxFilter& newFilter) {
+    beginResetModel();
+    bool wasActive = filterActive;
+    filter = newFilter;
+    if (wasActive && filter.isEmpty() && trimTData())
+        rebuildModelData();
+    else
+        applyFilter();
+    exposedRows = pageSize;
+    endResetModel();
+
+    fetchAllForFilter();
+}
+
+/**
+ * Recompute the rows that match the current filter. This runs on every keystroke in the search
+ * box, so it never scans the addresses or txids: text matches come from the prefix index, and 
+ * since rows are sorted by reverse time, the date range is a binary search.
+ */
+void TxTableModel::applyFilter() {
+    filteredRows.clear();
+    filterActive = modeldata != nullptr && !filter.isEmpty();
+    if (!filterActive)
+        return;
+
+    auto first = modeldata->constBegin();
+    auto last  = modeldata->constEnd();
+    if (filter.toTime > 0) {
+        first = std::lower_bound(first, last, filter.toTime, [=] (const TransactionItem& t, qint64 time) {
+            return t.datetime > time;
+        });
+    }
+    if (filter.fromTime > 0) {
+        last = std::lower_bound(first, last, filter.fromTime, [=] (const TransactionItem& t, qint64 time) {
+            return t.datetime >= time;
+        });
+    }
+    int firstRow = first - modeldata->constBegin();
+    int lastRow  = last  - modeldata->constBegin();
+
+    auto fnMatches = [=] (const TransactionItem& t) {
+        if (!filter.type.isEmpty() && t.type != filter.type)
+            return false;
+
+        auto amount = std::abs(t.amount);
+        if (filter.minAmount >= 0 && amount < filter.minAmount)
+            return false;
+        if (filter.maxAmount >= 0 && amount > filter.maxAmount)
+            return false;
+
+        return true;
+    };
+
+    if (filter.text.trimmed().isEmpty()) {
+        for (int row = firstRow; row < lastRow; row++) {
+            if (fnMatches(modeldata->at(row)))
+                filteredRows.push_back(row);
+        }
+    } else {
+        for (int id : searchIndex.lookupPrefix(filter.text)) {
+            int row = idToRow.value(id, -1);
+            if (row >= firstRow && row < lastRow && fnMatches(modeldata->at(row)))
+                filteredRows.push_back(row);
+        }
+        std::sort(filteredRows.begin(), filteredRows.end());
+    }
+}
+
+const TransactionItem& TxTableModel::itemAt(int row) const {
+    return filterActive ? modeldata->at(filteredRows.at(row)) : modeldata->at(row);
 }
 
  int TxTableModel::rowCount(const QModelIndex&) const
  {
     if (modeldata == nullptr) return 0;
-    return modeldata->size();
+    return std::min(exposedRows, availableRows());
  }
 
+// Number of rows that could be shown right now, ie. that match the filter and are not older than
+// the loaded t-transactions.
+int TxTableModel::availableRows() const {
+    if (modeldata == nullptr) 
+        return 0;
+
+    if (!filterActive)
+        return cutoffRow;
+
+    return std::lower_bound(filteredRows.begin(), filteredRows.end(), cutoffRow) - filteredRows.begin();
+}
+
+bool TxTableModel::canFetchMore(const QModelIndex& parent) const {
+    if (parent.isValid())
+        return false;
+
+    return rowCount(parent) < availableRows() || (tHasMore && !tFetchInProgress && tPageFetcher);
+}
+
+/**
+ * Called by the view when it is scrolled to the bottom. First hand out rows that are already
+ * loaded, and once those run out, ask the node for the next page of older t-transactions.
+ */
+void TxTableModel::fetchMore(const QModelIndex& parent) {
+    if (parent.isValid())
+        return;
+
+    int current   = rowCount(parent);
+    int available = availableRows();
+    if (current < available) {
+        int more = available - current;
+        if (more > pageSize) 
+            more = pageSize;
+
+        beginInsertRows(QModelIndex(), current, current + more - 1);
+        exposedRows = current + more;
+        endInsertRows();
+        return;
+    }
+
+    if (tHasMore && !tFetchInProgress && tPageFetcher) {
+        tFetchInProgress = true;
+        tPageFetcher(tDataCount(), pageSize);
+    }
+}
+
  int TxTableModel::columnCount(const QModelIndex&) const
  {
     return headers.size();
@@ -108,7 +474,7 @@ void TxTableModel::updateAllData() {
     if (role == Qt::TextAlignmentRole && index.column() == 3) return QVariant(Qt::AlignRight | Qt::AlignVCenter);
     
     if (role == Qt::ForegroundRole) {
-        if (modeldata->at(index.row()).confirmations == 0) {
+        if (itemAt(index.row()).confirmations == 0) {
             QBrush b;
             b.setColor(Qt::red);
             return b;
@@ -120,35 +486,35 @@ void TxTableModel::updateAllData() {
         return b;        
     }
 
-    auto dat = modeldata->at(index.row());
+    auto dat = itemAt(index.row());
     if (role == Qt::DisplayRole) {
         switch (index.column()) {
         case 0: return dat.type;
         case 1: { 
-                    auto addr = modeldata->at(index.row()).address;
+                    auto addr = itemAt(index.row()).address;
                     if (addr.trimmed().isEmpty()) 
                         return "(Shielded)";
                     else 
                         return addr;
                 }
-        case 2: return QDateTime::fromMSecsSinceEpoch(modeldata->at(index.row()).datetime *  (qint64)1000).toLocalTime().toString();
-        case 3: return Settings::getCMMDisplayFormat(modeldata->at(index.row()).amount);
+        case 2: return QDateTime::fromMSecsSinceEpoch(itemAt(index.row()).datetime *  (qint64)1000).toLocalTime().toString();
+        case 3: return Settings::getCMMDisplayFormat(itemAt(index.row()).amount);
         }
     } 
 
     if (role == Qt::ToolTipRole) {
         switch (index.column()) {
-        case 0: return modeldata->at(index.row()).type + 
+        case 0: return itemAt(index.row()).type + 
                     (dat.memo.isEmpty() ? "" : " tx memo: \"" + dat.memo + "\"");
         case 1: { 
-                    auto addr = modeldata->at(index.row()).address;
+                    auto addr = itemAt(index.row()).address;
                     if (addr.trimmed().isEmpty()) 
                         return "(Shielded)";
                     else 
                         return addr;
                 }
-        case 2: return QDateTime::fromMSecsSinceEpoch(modeldata->at(index.row()).datetime * (qint64)1000).toLocalTime().toString();
-        case 3: return Settings::getInstance()->getUSDFormat(modeldata->at(index.row()).amount);
+        case 2: return QDateTime::fromMSecsSinceEpoch(itemAt(index.row()).datetime * (qint64)1000).toLocalTime().toString();
+        case 3: return Settings::getInstance()->getUSDFormat(itemAt(index.row()).amount);
         }    
     }
 
@@ -187,13 +553,13 @@ void TxTableModel::updateAllData() {
  }
 
 QString TxTableModel::getTxId(int row) {
-    return modeldata->at(row).txid;
+    return itemAt(row).txid;
 }
 
 QString TxTableModel::getMemo(int row) {
-    return modeldata->at(row).memo;
+    return itemAt(row).memo;
 }
 
 QString TxTableModel::getAddr(int row) {
-    return modeldata->at(row).address.trimmed();
+    return itemAt(row).address.trimmed();
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 #define STRINGSTABLEMODEL_H
 
 #include "precompiled.h"
+#include "txsearchindex.h"
 
 struct TransactionItem;
 
@@ -11,23 +12,47 @@ public:
     TxTableModel(QObject* parent);    
     ~TxTableModel();
 
-    void addTData    (const QList<TransactionItem>& data);
+    void addTData    (const QList<TransactionItem>& data, bool hasMore = false);
+    void appendTData (const QList<TransactionItem>& data, bool hasMore);
     void addZSentData(const QList<TransactionItem>& data);
     void addZRecvData(const QList<TransactionItem>& data);     
 
+    void setFilter(const TxFilter& newFilter);
+
+    // Older t-transactions are loaded a page at a time, when the view scrolls down to them. 
+    // The fetcher is called with (from, count) and must answer with appendTData()
+    void setTPageFetcher(std::function<void(int, int)> fetcher) { tPageFetcher = fetcher; }
+    int  tDataCount() const { return tTrans == nullptr ? 0 : tTrans->size(); }
+
+    static const int pageSize       = 100;
+    static const int searchPageSize = 1000;     // Pages loaded in the background while searching
+
     QString  getTxId(int row);
     QString  getMemo(int row);
     QString  getAddr(int row);
 
-    bool     exportToCsv(QString fileName) const;
+    // The file is written on the I/O thread, and done is called with the result on the GUI thread
+    void     exportToCsv(QString fileName, std::function<void(bool)> done) const;
 
     int      rowCount(const QModelIndex &parent) const;
     int      columnCount(const QModelIndex &parent) const;
+    bool     canFetchMore(const QModelIndex &parent) const;
+    void     fetchMore(const QModelIndex &parent);
     QVariant data(const QModelIndex &index, int role) const;
     QVariant headerData(int section, Qt::Orientation orientation, int role) const;
 
 private:
     void updateAllData();
+    void rebuildModelData();
+    bool trimTData();
+    void reassignIds();
+    QVector<int> assignIds(const QList<TransactionItem>* prev, const QVector<int>& prevIds, 
+                           const QList<TransactionItem>& next);
+    void applyFilter();
+    void fetchAllForFilter();
+    int  availableRows() const;
+
+    const TransactionItem& itemAt(int row) const;
 
     QList<TransactionItem>*  tTrans      = nullptr;
     QList<TransactionItem>*  zrTrans     = nullptr;     // Z received
@@ -35,6 +60,27 @@ private:
 
     QList<TransactionItem>* modeldata    = nullptr;
 
+    // Search index over modeldata. Rows get a stable id the first time they are seen, 
+    // so that the index only has to be updated with the rows that were added or removed.
+    TxSearchIndex            searchIndex;
+    QVector<int>             tIds;                      // Stable id of each row in tTrans
+    QSet<QString>            tKeys;                     // Type, txid and address of each row in tTrans
+    QVector<int>             zrIds;
+    QVector<int>             zsIds;
+    QVector<int>             idToRow;                   // Stable id -> row in modeldata, or -1
+    int                      nextId      = 0;
+
+    TxFilter                 filter;
+    bool                     filterActive = false;
+    QVector<int>             filteredRows;              // Rows in modeldata that match the filter
+
+    std::function<void(int, int)> tPageFetcher;
+    bool                     tHasMore         = false;  // The node has older t-transactions we haven't loaded
+    bool                     tFetchInProgress = false;
+    bool                     tDiscardFetch    = false;  // The page being fetched follows pages that were dropped
+    int                      cutoffRow        = 0;      // Rows past this are older than the loaded t-transactions
+    int                      exposedRows      = pageSize; // Number of rows the view has been given so far
+
     QList<QString>           headers;
 };
 
@@ -0,0 +1,697 @@
+#include "walletstore.h"
+#include "settings.h"
+#include "ioexecutor.h"
+#include "logger.h"
+
+#include <cstring>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+WalletStore* WalletStore::instance = nullptr;
+std::shared_future<QPair<QString, QByteArray>> WalletStore::preloading;
+
+static const char magic[] = "CMMSTOR1";
+
+// Make sure everything written to the file is on the disk
+static void syncToDisk(QFile* file) {
+    file->flush();
+#ifdef Q_OS_WIN
+    _commit(file->handle());
+#else
+    fsync(file->handle());
+#endif
+}
+
+// Approximate size of an entry in the file, used to decide when to compact
+static qint64 entrySize(const QString& ns, const QString& key, qint64 length) {
+    return 9 + ns.size() + key.size() + length;
+}
+
+WalletStore* WalletStore::getInstance() {
+    if (instance == nullptr)
+        instance = new WalletStore();
+
+    return instance;
+}
+
+// Each network has its own file, and we only find out that we're on testnet after connecting. Batches
+// that haven't been written would be lost when the old file is closed, so that has to work first.
+void WalletStore::switchNetwork() {
+    auto name = writeableFile();
+    if (name == filename) {
+        switchPending = false;
+        return;
+    }
+
+    if (!sync()) {
+        switchPending = true;
+        return;
+    }
+
+    switchPending = false;
+    close();
+    open();
+}
+
+// The store is read when the address book is first used, which is while the main window is being
+// set up. Read the file on another thread in the meantime, so that doesn't have to wait for the disk.
+void WalletStore::preload() {
+    auto name = writeableFile();
+    preloading = std::async(std::launch::async, [=] () {
+        QByteArray bytes;
+
+        QFile f(name);
+        if (f.open(QIODevice::ReadOnly))
+            bytes = f.readAll();
+
+        return QPair<QString, QByteArray>(name, bytes);
+    }).share();
+}
+
+WalletStore::WalletStore() : writeFailed(false), ioStopped(false) {
+    open();
+}
+
+QString WalletStore::writeableFile() {
+    auto filename = QStringLiteral("walletstore.dat");
+
+    auto dir = QDir(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation));
+    if (!dir.exists())
+        QDir().mkpath(dir.absolutePath());
+
+    if (Settings::getInstance()->isTestnet()) {
+        return dir.filePath("testnet-" % filename);
+    } else {
+        return dir.filePath(filename);
+    }
+}
+
+void WalletStore::open() {
+    filename = writeableFile();
+    file     = new QFile(filename);
+    if (!file->open(QIODevice::ReadWrite)) {
+        delete file;
+        file = nullptr;
+        return;
+    }
+
+    fileSize = file->size();
+    if (fileSize == 0) {
+        file->write(magic, headerSize);
+        syncToDisk(file);
+        fileSize = headerSize;
+    }
+
+    // Use the preloaded contents if they are for this file, and it hasn't changed since
+    QPair<QString, QByteArray> preloaded;
+    if (preloading.valid()) {
+        preloaded  = preloading.get();
+        preloading = std::shared_future<QPair<QString, QByteArray>>();
+    }
+
+    if (preloaded.first == filename && preloaded.second.size() == fileSize) {
+        contents = preloaded.second;
+        data     = contents.constData();
+        dataSize = fileSize;
+    } else {
+        map();
+    }
+
+    // Drop a batch that was only partially written when we crashed, so new ones are not appended
+    // after it. If the file isn't one of ours at all, start over.
+    auto goodEnd = replay();
+    if (goodEnd < fileSize) {
+        unmap();
+        if (goodEnd == 0) {
+            file->resize(0);
+            file->seek(0);
+            file->write(magic, headerSize);
+            goodEnd = headerSize;
+        } else {
+            file->resize(goodEnd);
+        }
+        syncToDisk(file);
+
+        fileSize = goodEnd;
+        map();
+    }
+
+    durableSize = fileSize;
+}
+
+void WalletStore::close() {
+    unmap();
+    if (file != nullptr) {
+        file->close();
+        delete file;
+        file = nullptr;
+    }
+
+    index.clear();
+    batch.clear();
+    batchKeys.clear();
+    inflight.clear();
+    fileSize    = 0;
+    durableSize = 0;
+    liveBytes   = 0;
+    nextSeq     = 0;
+    compacting  = false;
+    compactImage.clear();
+    failed      = false;
+    recovering  = false;
+    ioStopped   = false;
+
+    // Callbacks for writes to the old file no longer apply
+    generation++;
+}
+
+bool WalletStore::map() {
+    dataSize = fileSize;
+
+    mapped = file->map(0, fileSize);
+    if (mapped != nullptr) {
+        data = reinterpret_cast<const char*>(mapped);
+        return true;
+    }
+
+    // Some file systems can't be mapped, so just read the whole file instead
+    file->seek(0);
+    contents = file->read(fileSize);
+    data     = contents.constData();
+    return false;
+}
+
+void WalletStore::unmap() {
+    if (mapped != nullptr) {
+        file->unmap(mapped);
+        mapped = nullptr;
+    }
+    contents.clear();
+    data     = nullptr;
+    dataSize = 0;
+}
+
+/**
+ * Build the index from the file. Each batch is a length and a checksum, followed by the ops:
+ *      op (1 byte), namespace length (2), namespace, key length (2), key,
+ *      and for a put, value length (4) and value
+ * All numbers are little endian. Returns the offset just past the last good batch.
+ */
+qint64 WalletStore::replay() {
+    index.clear();
+    liveBytes = 0;
+    nextSeq   = 0;
+
+    if (fileSize < headerSize || memcmp(data, magic, headerSize) != 0)
+        return 0;
+
+    auto fnRead16 = [=] (qint64 pos) { return qFromLittleEndian<quint16>(reinterpret_cast<const uchar*>(data + pos)); };
+    auto fnRead32 = [=] (qint64 pos) { return qFromLittleEndian<quint32>(reinterpret_cast<const uchar*>(data + pos)); };
+
+    qint64 pos = headerSize;
+    while (pos + frameHeaderSize <= fileSize) {
+        qint64 start  = pos + frameHeaderSize;
+        qint64 length = fnRead32(pos);
+        if (start + length > fileSize || crc32(data + start, length) != fnRead32(pos + 4))
+            break;
+
+        qint64 p   = start;
+        qint64 end = start + length;
+        while (p + 3 <= end) {
+            auto op    = (Op)data[p];
+            auto nsLen = fnRead16(p + 1);
+            p += 3;
+            if (p + nsLen + 2 > end)
+                break;
+            auto ns = QString::fromUtf8(data + p, nsLen);
+            p += nsLen;
+
+            auto keyLen = fnRead16(p);
+            p += 2;
+            if (p + keyLen > end)
+                break;
+            auto key = QString::fromUtf8(data + p, keyLen);
+            p += keyLen;
+
+            auto& nsIndex  = index[ns];
+            auto  existing = nsIndex.find(key);
+            if (existing != nsIndex.end()) {
+                liveBytes -= entrySize(ns, key, existing->length);
+                nsIndex.erase(existing);
+            }
+
+            if (op == Op::Put) {
+                if (p + 4 > end)
+                    break;
+                auto valLen = fnRead32(p);
+                p += 4;
+                if (p + valLen > end)
+                    break;
+
+                nsIndex.insert(key, Entry{ p, valLen, nextSeq++, true });
+                liveBytes += entrySize(ns, key, valLen);
+                p += valLen;
+            }
+        }
+
+        pos = end;
+    }
+
+    return pos;
+}
+
+// Serialize the op into out, and return the offset of the value in out
+qint64 WalletStore::writeOp(QByteArray& out, Op op, const QString& ns, const QString& key,
+                            const QByteArray& value) {
+    auto nsUtf8  = ns.toUtf8();
+    auto keyUtf8 = key.toUtf8();
+    uchar buf[4];
+
+    out.append((char)op);
+    qToLittleEndian<quint16>(nsUtf8.size(), buf);
+    out.append(reinterpret_cast<const char*>(buf), 2);
+    out.append(nsUtf8);
+    qToLittleEndian<quint16>(keyUtf8.size(), buf);
+    out.append(reinterpret_cast<const char*>(buf), 2);
+    out.append(keyUtf8);
+
+    if (op != Op::Put)
+        return -1;
+
+    qToLittleEndian<quint32>(value.size(), buf);
+    out.append(reinterpret_cast<const char*>(buf), 4);
+
+    auto valueOffset = out.size();
+    out.append(value);
+    return valueOffset;
+}
+
+// Add the op to the current batch, and apply it to the index right away, so reads see it.
+void WalletStore::appendOp(Op op, const QString& ns, const QString& key, const QByteArray& value) {
+    // Group all the writes until we get back to the event loop into one commit
+    if (batch.isEmpty()) {
+        QTimer::singleShot(0, [=] () { commit(); });
+    }
+
+    auto valueOffset = writeOp(batch, op, ns, key, value);
+
+    auto& nsIndex  = index[ns];
+    auto  existing = nsIndex.find(key);
+    if (existing != nsIndex.end()) {
+        liveBytes -= entrySize(ns, key, existing->length);
+        nsIndex.erase(existing);
+    }
+
+    if (op == Op::Put) {
+        nsIndex.insert(key, Entry{ valueOffset, (quint32)value.size(), nextSeq++, false });
+        liveBytes += entrySize(ns, key, value.size());
+        batchKeys.push_back(QPair<QString, QString>(ns, key));
+    }
+}
+
+QByteArray WalletStore::read(const Entry& entry) const {
+    if (!entry.committed)
+        return batch.mid(entry.offset, entry.length);
+
+    if (data != nullptr && entry.offset + entry.length <= dataSize)
+        return QByteArray(data + entry.offset, entry.length);
+
+    // The batch is still being written
+    auto it = inflight.upperBound(entry.offset);
+    if (it == inflight.constBegin())
+        return QByteArray();
+    it--;
+
+    return it.value().mid(entry.offset - it.key(), entry.length);
+}
+
+QByteArray WalletStore::value(const QString& ns, const QString& key) const {
+    auto nsIndex = index.constFind(ns);
+    if (nsIndex == index.constEnd())
+        return QByteArray();
+
+    auto entry = nsIndex->constFind(key);
+    if (entry == nsIndex->constEnd())
+        return QByteArray();
+
+    return read(*entry);
+}
+
+bool WalletStore::contains(const QString& ns, const QString& key) const {
+    auto nsIndex = index.constFind(ns);
+    return nsIndex != index.constEnd() && nsIndex->contains(key);
+}
+
+bool WalletStore::isEmpty(const QString& ns) const {
+    auto nsIndex = index.constFind(ns);
+    return nsIndex == index.constEnd() || nsIndex->isEmpty();
+}
+
+QList<QPair<QString, const WalletStore::Entry*>> WalletStore::sortedEntries(const QString& ns) const {
+    QList<QPair<QString, const Entry*>> entries;
+
+    auto nsIndex = index.constFind(ns);
+    if (nsIndex == index.constEnd())
+        return entries;
+
+    for (auto it = nsIndex->constBegin(); it != nsIndex->constEnd(); it++) {
+        entries.push_back(QPair<QString, const Entry*>(it.key(), &it.value()));
+    }
+
+    std::sort(entries.begin(), entries.end(), [] (const auto& a, const auto& b) {
+        return a.second->seq < b.second->seq;
+    });
+
+    return entries;
+}
+
+QList<QPair<QString, QByteArray>> WalletStore::values(const QString& ns) const {
+    QList<QPair<QString, QByteArray>> values;
+    for (const auto& entry : sortedEntries(ns)) {
+        values.push_back(QPair<QString, QByteArray>(entry.first, read(*entry.second)));
+    }
+
+    return values;
+}
+
+void WalletStore::put(const QString& ns, const QString& key, const QByteArray& value) {
+    appendOp(Op::Put, ns, key, value);
+}
+
+void WalletStore::remove(const QString& ns, const QString& key) {
+    if (contains(ns, key))
+        appendOp(Op::Remove, ns, key, QByteArray());
+}
+
+void WalletStore::clear(const QString& ns) {
+    auto nsIndex = index.constFind(ns);
+    if (nsIndex == index.constEnd())
+        return;
+
+    for (const auto& key : nsIndex->keys()) {
+        appendOp(Op::Remove, ns, key, QByteArray());
+    }
+}
+
+QByteArray WalletStore::frameHeader(const QByteArray& payload) {
+    QByteArray frame(frameHeaderSize, 0);
+    qToLittleEndian<quint32>(payload.size(), reinterpret_cast<uchar*>(frame.data()));
+    qToLittleEndian<quint32>(crc32(payload.constData(), payload.size()), reinterpret_cast<uchar*>(frame.data() + 4));
+
+    return frame;
+}
+
+/**
+ * Write out the current batch as a single checksummed frame, and fsync it. The write happens on the
+ * I/O thread. Until it is done, the values are read from the copy in inflight.
+ */
+bool WalletStore::commit() {
+    // Nothing is appended until the file has been repaired. The batch stays queued until then.
+    if (failed) {
+        if (!recovering)
+            recover();
+        return false;
+    }
+
+    if (batch.isEmpty())
+        return true;
+
+    if (file == nullptr && !compacting)
+        return false;
+
+    auto base = fileSize + frameHeaderSize;
+    fileSize += frameHeaderSize + batch.size();
+
+    for (const auto& key : batchKeys) {
+        auto nsIndex = index.find(key.first);
+        if (nsIndex == index.end())
+            continue;
+
+        auto entry = nsIndex->find(key.second);
+        if (entry != nsIndex->end() && !entry->committed) {
+            entry->offset   += base;
+            entry->committed = true;
+        }
+    }
+
+    auto bytes = frameHeader(batch) + batch;
+    inflight.insert(base, batch);
+    batch.clear();
+    batchKeys.clear();
+
+    auto name = filename;
+    auto gen  = generation;
+    auto ok   = std::make_shared<bool>(false);
+    IOExecutor::getInstance()->submit([=] () {
+        // Anything appended after a failed write would be lost behind it when the file is read
+        if (ioStopped)
+            return;
+
+        QFile out(name);
+        *ok = out.open(QIODevice::WriteOnly | QIODevice::Append) && out.write(bytes) == bytes.size();
+        if (*ok) {
+            syncToDisk(&out);
+        } else {
+            writeFailed = true;
+            ioStopped   = true;
+        }
+    }, [=] () {
+        commitFinished(gen, base, *ok);
+    });
+
+    return true;
+}
+
+bool WalletStore::sync() {
+    writeFailed = false;
+
+    bool ok = commit();
+    IOExecutor::getInstance()->waitForIdle();
+
+    return ok && !writeFailed;
+}
+
+void WalletStore::commitFinished(int gen, qint64 base, bool ok) {
+    if (gen != generation)
+        return;
+
+    // The batches queued after this one were skipped. They are all still in inflight.
+    if (!ok) {
+        if (!failed)
+            fail(QObject::tr("Couldn't write to ") % filename);
+        return;
+    }
+
+    durableSize = base + inflight.value(base).size();
+    inflight.remove(base);
+
+    // Map the new batches once they have all been written
+    if (!inflight.isEmpty() || file == nullptr)
+        return;
+
+    unmap();
+    map();
+
+    // Once most of the file is old values, rewrite it with just the live ones
+    if (!compacting && fileSize > minCompactSize && fileSize > 2 * liveBytes) {
+        compact();
+    }
+}
+
+/**
+ * Rewrite the file with a single batch that has all the live entries, in the order they were
+ * written. QSaveFile writes to a temp file and renames it over the old one, so a crash half way
+ * through leaves the old file in place. Until that is done, reads are served from the new contents
+ * in memory, and new batches are queued to be appended after it.
+ */
+void WalletStore::compact() {
+    QByteArray ops;
+    for (const auto& ns : index.keys()) {
+        for (const auto& entry : sortedEntries(ns)) {
+            writeOp(ops, Op::Put, ns, entry.first, read(*entry.second));
+        }
+    }
+
+    QByteArray image(magic, headerSize);
+    image += frameHeader(ops);
+    image += ops;
+    compactImage = image;
+
+    // The old file has to be closed before it can be replaced on Windows
+    unmap();
+    file->close();
+    delete file;
+    file = nullptr;
+
+    contents = image;
+    data     = contents.constData();
+    dataSize = fileSize = image.size();
+    replay();
+
+    compacting = true;
+
+    auto name = filename;
+    auto gen  = generation;
+    auto ok   = std::make_shared<bool>(false);
+    IOExecutor::getInstance()->submit([=] () {
+        QSaveFile out(name);
+        *ok = out.open(QIODevice::WriteOnly) && out.write(image) == image.size() && out.commit();
+        if (!*ok) {
+            writeFailed = true;
+            ioStopped   = true;
+        }
+    }, [=] () {
+        compactFinished(gen, *ok);
+    });
+}
+
+void WalletStore::compactFinished(int gen, bool ok) {
+    if (gen != generation)
+        return;
+
+    compacting = false;
+
+    // The old file is still there. The compacted one is written again when the file is repaired.
+    if (!ok) {
+        fail(QObject::tr("Couldn't compact ") % filename);
+        return;
+    }
+
+    durableSize = compactImage.size();
+    compactImage.clear();
+
+    file = new QFile(filename);
+    if (!file->open(QIODevice::ReadWrite)) {
+        delete file;
+        file = nullptr;
+        fail(QObject::tr("Couldn't open ") % filename);
+        return;
+    }
+
+    if (inflight.isEmpty()) {
+        unmap();
+        map();
+    }
+}
+
+void WalletStore::fail(const QString& what) {
+    failed = true;
+    if (logger != nullptr)
+        LOG(logger, Error, General, what);
+
+    recover();
+
+    if (failureCallback)
+        failureCallback(what);
+}
+
+/**
+ * Repair the file after a failed write: cut it back to the last batch that is known to be on the disk
+ * (or write the compacted file again, if that is what failed), and then write every batch that is
+ * still in inflight, in order, so each one lands at the offset the index already has for it.
+ */
+void WalletStore::recover() {
+    recovering = true;
+
+    // Cutting back or replacing a mapped file fails on Windows, and leaves the mapping dangling
+    // elsewhere. Read from a copy until the file has been repaired and mapped again.
+    if (mapped != nullptr) {
+        QByteArray copy(data, dataSize);
+        unmap();
+        contents = copy;
+        data     = contents.constData();
+        dataSize = contents.size();
+    }
+
+    QByteArray frames;
+    for (auto it = inflight.constBegin(); it != inflight.constEnd(); it++) {
+        frames += frameHeader(it.value()) + it.value();
+    }
+
+    auto name  = filename;
+    auto gen   = generation;
+    auto image = compactImage;
+    auto good  = durableSize;
+    auto ok    = std::make_shared<bool>(false);
+    IOExecutor::getInstance()->submit([=] () {
+        if (!image.isEmpty()) {
+            QSaveFile out(name);
+            if (!out.open(QIODevice::WriteOnly) || out.write(image) != image.size() || !out.commit())
+                return;
+        } else {
+            QFile out(name);
+            if (!out.open(QIODevice::ReadWrite) || !out.resize(good))
+                return;
+        }
+
+        QFile out(name);
+        *ok = out.open(QIODevice::WriteOnly | QIODevice::Append) && out.write(frames) == frames.size();
+        if (*ok) {
+            syncToDisk(&out);
+            ioStopped = false;
+        }
+    }, [=] () {
+        recoverFinished(gen, *ok);
+    });
+}
+
+void WalletStore::recoverFinished(int gen, bool ok) {
+    if (gen != generation)
+        return;
+
+    recovering = false;
+
+    if (!ok) {
+        QTimer::singleShot(retryInterval, [=] () { commit(); });
+        return;
+    }
+
+    failed      = false;
+    durableSize = fileSize;
+    inflight.clear();
+    compactImage.clear();
+
+    if (file == nullptr) {
+        file = new QFile(filename);
+        if (!file->open(QIODevice::ReadWrite)) {
+            delete file;
+            file = nullptr;
+        }
+    }
+
+    if (file != nullptr) {
+        unmap();
+        map();
+    }
+
+    // Write out what was put while the file was being repaired
+    commit();
+
+    if (switchPending)
+        switchNetwork();
+}
+
+quint32 WalletStore::crc32(const char* data, qint64 length) {
+    static const std::vector<quint32> table = [] () {
+        std::vector<quint32> t(256);
+        for (quint32 i = 0; i < 256; i++) {
+            quint32 c = i;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+            }
+            t[i] = c;
+        }
+        return t;
+    }();
+
+    quint32 crc = 0xFFFFFFFF;
+    for (qint64 i = 0; i < length; i++) {
+        crc = table[(crc ^ (uchar)data[i]) & 0xFF] ^ (crc >> 8);
+    }
+
+    return crc ^ 0xFFFFFFFF;
+}
@@ -0,0 +1,142 @@
+#ifndef WALLETSTORE_H
+#define WALLETSTORE_H
+
+#include "precompiled.h"
+
+class Logger;
+
+/**
+ * Small embedded key/value store for the data the wallet keeps outside of commerciumd, like the
+ * address labels, the sent z-txs and the turnstile migration plan. Keys are grouped by namespace,
+ * one per subsystem.
+ *
+ * Each network has a single append-only file. Every commit appends one checksummed batch of puts
+ * and removes, and fsyncs it, so the file is its own write-ahead log. On open, the file is mmap'd
+ * and scanned once to build an index, and values are read straight out of the mapping. A torn batch
+ * at the end (from a crash while writing it) is dropped. Once most of the file is overwritten or
+ * removed values, it is rewritten with only the live ones.
+ *
+ * Writes are grouped: everything that is put or removed before control returns to the event loop
+ * goes out as a single batch. Call commit() to write it out right away. The writes themselves are
+ * done on the IOExecutor thread. Batches that are still being written are read from memory.
+ *
+ * If a write fails, nothing more is appended after it. The batches that haven't made it to the disk
+ * stay in memory, the file is cut back to the last good batch, and they are written again. Until
+ * that works, commit() returns false and it is retried every so often.
+ *
+ * The store starts out on the mainnet file. Call switchNetwork() once the network is known. The old
+ * file stays open until everything written to it is on the disk.
+ */
+class WalletStore {
+public:
+    static WalletStore* getInstance();
+
+    // Start reading the store in the background, so it is ready by the time it is needed
+    static void         preload();
+
+    // Move to the file for the network in Settings. If the current file can't be written out, this
+    // waits until it has been repaired.
+    void                switchNetwork();
+
+    QByteArray          value(const QString& ns, const QString& key) const;
+    bool                contains(const QString& ns, const QString& key) const;
+    bool                isEmpty(const QString& ns) const;
+
+    // All the keys and values in the namespace, in the order they were written
+    QList<QPair<QString, QByteArray>> values(const QString& ns) const;
+
+    void                put(const QString& ns, const QString& key, const QByteArray& value);
+    void                remove(const QString& ns, const QString& key);
+    void                clear(const QString& ns);
+
+    // Returns false if the batch couldn't be written out, because an earlier write failed
+    bool                commit();
+
+    // Commit, and wait until everything is on the disk. Returns false if any write failed.
+    bool                sync();
+
+    // Failed writes are logged, and then cb is called on the GUI thread with a description
+    void                setLogger(Logger* l) { logger = l; }
+    void                setFailureCallback(std::function<void(QString)> cb) { failureCallback = cb; }
+    bool                isFailing() const { return failed; }
+
+private:
+    WalletStore();
+
+    enum Op {
+        Put = 1,
+        Remove
+    };
+
+    struct Entry {
+        qint64      offset;         // Of the value, in the file if committed, else in the batch
+        quint32     length;
+        quint64     seq;            // Order in which the entries were written
+        bool        committed;
+    };
+
+    void                open();
+    void                close();
+    bool                map();
+    void                unmap();
+    qint64              replay();
+    void                compact();
+
+    void                commitFinished(int gen, qint64 base, bool ok);
+    void                compactFinished(int gen, bool ok);
+
+    void                fail(const QString& what);
+    void                recover();
+    void                recoverFinished(int gen, bool ok);
+
+    void                appendOp(Op op, const QString& ns, const QString& key, const QByteArray& value);
+    static qint64       writeOp(QByteArray& out, Op op, const QString& ns, const QString& key,
+                                const QByteArray& value);
+    static QByteArray   frameHeader(const QByteArray& payload);
+    QByteArray          read(const Entry& entry) const;
+    QList<QPair<QString, const Entry*>> sortedEntries(const QString& ns) const;
+
+    static QString      writeableFile();
+    static quint32      crc32(const char* data, qint64 length);
+
+    QString             filename;
+    QFile*              file        = nullptr;  // Used to map the file. nullptr while it is being compacted.
+    uchar*              mapped      = nullptr;
+    QByteArray          contents;               // Used instead of the mapping if the file can't be mapped,
+                                                // was preloaded, or is being compacted
+    const char*         data        = nullptr;  // Either the mapping or contents
+    qint64              dataSize    = 0;        // How much of the file is in data
+    qint64              fileSize    = 0;        // Including the batches that are still being written
+    qint64              durableSize = 0;        // How much of the file is known to be on the disk
+    qint64              liveBytes   = 0;        // Roughly, how much of the file is still in use
+
+    QHash<QString, QHash<QString, Entry>> index;
+    quint64             nextSeq     = 0;
+
+    QByteArray                      batch;          // Ops that haven't been committed yet
+    QList<QPair<QString, QString>>  batchKeys;      // Keys that were put in this batch
+    QMap<qint64, QByteArray>        inflight;       // Batches being written, by their offset in the file
+
+    int                 generation  = 0;        // Changes when the file is closed, so stale callbacks are ignored
+    bool                compacting  = false;
+    QByteArray          compactImage;           // The compacted file, until it is on the disk
+    std::atomic<bool>   writeFailed;
+
+    bool                failed      = false;    // A write failed, and the file hasn't been repaired yet
+    bool                recovering  = false;
+    bool                switchPending = false;  // switchNetwork() is waiting for the file to be repaired
+    std::atomic<bool>   ioStopped;              // Set on the I/O thread, so queued appends are skipped
+
+    Logger*             logger      = nullptr;
+    std::function<void(QString)> failureCallback;
+
+    static const int    headerSize      = 8;        // Magic at the start of the file
+    static const int    frameHeaderSize = 8;        // Length and checksum at the start of each batch
+    static const int    minCompactSize  = 256 * 1024;
+    static const int    retryInterval   = 30 * 1000; // ms between attempts to repair the file
+
+    static WalletStore*                 instance;
+    static std::shared_future<QPair<QString, QByteArray>> preloading;   // File name and contents
+};
+
+#endif // WALLETSTORE_H